@@ -51,9 +51,27 @@ void DNSServer::downcaseAndRemoveWwwPrefix(String &domainName)
   domainName.replace("www.", "");
 }
 
+void DNSServer::useReactor(bool enable)
+{
+  if (!enable)
+  {
+    _udp.onReceive(nullptr);
+    return;
+  }
+  _udp.onReceive([this](WiFiUDP &udp) {
+    _currentPacketSize = udp.available();
+    processRequest();
+  });
+}
+
 void DNSServer::processNextRequest()
 {
   _currentPacketSize = _udp.parsePacket();
+  processRequest();
+}
+
+void DNSServer::processRequest()
+{
   if (_currentPacketSize)
   {
     // Allocate buffer for the DNS query
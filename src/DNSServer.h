@@ -87,6 +87,9 @@ class DNSServer
     // stops the DNS server
     void stop();
 
+    // answer requests from WiFiReactor.poll() instead of processNextRequest()
+    void useReactor(bool enable = true);
+
   private:
     WiFiUDP _udp;
     uint16_t _port;
@@ -100,6 +103,7 @@ class DNSServer
     DNSQuestion*    _dnsQuestion ; 
 
 
+    void processRequest();
     void downcaseAndRemoveWwwPrefix(String &domainName);
     String getDomainNameWithoutWwwPrefix();
     bool requestIncludesOnlyOneQuestion();
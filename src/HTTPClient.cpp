@@ -37,6 +37,7 @@
 #include <base64.h>
 
 #include "HTTPClient.h"
+#include "HTTPInflater.h"
 
 // #define log_d Serial.printf
 
@@ -106,6 +107,7 @@ HTTPClient::~HTTPClient()
     if(_currentHeaders) {
         delete[] _currentHeaders;
     }
+    freeStreamBuffer();
 }
 
 void HTTPClient::clear()
@@ -177,6 +179,7 @@ bool HTTPClient::begin(WiFiClient &client, String host, uint16_t port, String ur
     _host = host;
     _port = port;
     _uri = uri;
+    _headerTemplateValid = false;
     _protocol = (https ? "https" : "http");
     return true;
 }
@@ -262,6 +265,7 @@ bool HTTPClient::beginInternal(String url, const char* expectedProtocol)
         String auth = host.substring(0, index);
         host.remove(0, index + 1); // remove auth part including @
         _base64Authorization = base64::encode(auth);
+        _base64Authorization.replace("\n", "");
     }
 
     // get port
@@ -274,6 +278,7 @@ bool HTTPClient::beginInternal(String url, const char* expectedProtocol)
         _host = host;
     }
     _uri = url;
+    _headerTemplateValid = false;
     log_d("host: %s port: %d url: %s", _host.c_str(), _port, _uri.c_str());
     return true;
 }
@@ -291,6 +296,7 @@ bool HTTPClient::begin(String host, uint16_t port, String uri)
     _host = host;
     _port = port;
     _uri = uri;
+    _headerTemplateValid = false;
     _transportTraits = TransportTraitsPtr(new TransportTraits());
     log_d("host: %s port: %d uri: %s", host.c_str(), port, uri.c_str());
     return true;
@@ -308,6 +314,7 @@ bool HTTPClient::begin(String host, uint16_t port, String uri, const char* CAcer
     _host = host;
     _port = port;
     _uri = uri;
+    _headerTemplateValid = false;
 
     if (strlen(CAcert) == 0) {
         return false;
@@ -329,6 +336,7 @@ bool HTTPClient::begin(String host, uint16_t port, String uri, const char* CAcer
     _host = host;
     _port = port;
     _uri = uri;
+    _headerTemplateValid = false;
 
     if (strlen(CAcert) == 0) {
         return false;
@@ -406,6 +414,7 @@ bool HTTPClient::connected()
 void HTTPClient::setReuse(bool reuse)
 {
     _reuse = reuse;
+    _headerTemplateValid = false;
 }
 
 /**
@@ -415,6 +424,7 @@ void HTTPClient::setReuse(bool reuse)
 void HTTPClient::setUserAgent(const String& userAgent)
 {
     _userAgent = userAgent;
+    _headerTemplateValid = false;
 }
 
 /**
@@ -429,6 +439,8 @@ void HTTPClient::setAuthorization(const char * user, const char * password)
         auth += ":";
         auth += password;
         _base64Authorization = base64::encode(auth);
+        _base64Authorization.replace("\n", "");
+        _headerTemplateValid = false;
     }
 }
 
@@ -440,6 +452,8 @@ void HTTPClient::setAuthorization(const char * auth)
 {
     if(auth) {
         _base64Authorization = auth;
+        _base64Authorization.replace("\n", "");
+        _headerTemplateValid = false;
     }
 }
 
@@ -464,6 +478,46 @@ void HTTPClient::setTimeout(uint16_t timeout)
     }
 }
 
+/**
+ * use a caller-supplied buffer for receiving the message body
+ * the buffer must stay valid as long as the HTTPClient uses it
+ * @param buffer uint8_t *
+ * @param size size_t
+ */
+void HTTPClient::setStreamBuffer(uint8_t * buffer, size_t size)
+{
+    freeStreamBuffer();
+    if(buffer && size) {
+        _streamBuffer = buffer;
+        _streamBufferSize = size;
+    }
+}
+
+/**
+ * set the size of the pooled receive buffer, allocated once on first use
+ * @param size size_t
+ */
+void HTTPClient::setStreamBufferSize(size_t size)
+{
+    freeStreamBuffer();
+    if(size) {
+        _streamBufferSize = size;
+    }
+}
+
+/**
+ * advertise gzip and decode gzip encoded response bodies on the fly
+ * @param gzip bool
+ * @param window size_t  history buffer for the decoder, streams needing
+ *                       a larger one fail with HTTPC_ERROR_DECODING
+ */
+void HTTPClient::setAcceptGzip(bool gzip, size_t window)
+{
+    _acceptGzip = gzip;
+    _gzipWindow = window;
+    _headerTemplateValid = false;
+}
+
 /**
  * use HTTP1.0
  * @param use
@@ -472,6 +526,7 @@ void HTTPClient::useHTTP10(bool useHTTP10)
 {
     _useHTTP10 = useHTTP10;
     _reuse = !useHTTP10;
+    _headerTemplateValid = false;
 }
 
 /**
@@ -552,6 +607,10 @@ int HTTPClient::sendRequest(const char * type, uint8_t * payload, size_t size)
     int code;
     bool redirect = false;
     uint16_t redirectCount = 0;
+    unsigned long redirectStart = 0;
+
+    memset(&_redirectStats, 0, sizeof(_redirectStats));
+
     do {
         // wipe out any existing headers from previous request
         for(size_t i = 0; i < _headerKeysCount; i++) {
@@ -616,6 +675,7 @@ int HTTPClient::sendRequest(const char * type, uint8_t * payload, size_t size)
                     ) {
                         redirectCount += 1;
                         log_d("following redirect (the same method): '%s' redirCount: %d\n", _location.c_str(), redirectCount);
+                        discardBody(type);
                         if (!setURL(_location)) {
                             log_d("failed setting URL for redirection\n");
                             // no redirection
@@ -632,6 +692,7 @@ int HTTPClient::sendRequest(const char * type, uint8_t * payload, size_t size)
                 case HTTP_CODE_SEE_OTHER: {
                     redirectCount += 1;
                     log_d("following redirect (dropped to GET/HEAD): '%s' redirCount: %d\n", _location.c_str(), redirectCount);
+                    discardBody(type);
                     if (!setURL(_location)) {
                         log_d("failed setting URL for redirection\n");
                         // no redirection
@@ -650,7 +711,18 @@ int HTTPClient::sendRequest(const char * type, uint8_t * payload, size_t size)
             }
         }
 
+        if(redirect && !redirectStart) {
+            redirectStart = millis();
+        }
+
     } while (redirect);
+
+    if(redirectCount) {
+        _redirectStats.redirects = redirectCount;
+        _redirectStats.latency = millis() - redirectStart;
+        log_d("redirect chain: %d hops, %d reused, %d ms", redirectCount, _redirectStats.reused, _redirectStats.latency);
+    }
+
     // handle Server Response (Header)
     return returnError(code);
 }
@@ -794,6 +866,124 @@ int HTTPClient::sendRequest(const char * type, Stream * stream, size_t size)
     return returnError(handleHeaderResponse());
 }
 
+/**
+ * sendChunkedRequest
+ * sends the body produced by generator with Transfer-Encoding: chunked,
+ * so it never has to be in RAM as a whole. Small generator outputs are
+ * coalesced and every chunk goes out in a single, MSS aligned write.
+ * @param type const char *     "GET", "POST", ....
+ * @param generator HTTPBodyGenerator
+ * @return -1 if no info or > 0 when Content-Length is set by server
+ */
+int HTTPClient::sendChunkedRequest(const char * type, HTTPBodyGenerator generator)
+{
+    // room for the chunk size line ("5b4\r\n") and the trailing "\r\n"
+    const size_t headRoom = 5;
+    const size_t tailRoom = 2;
+    const char lastChunk[] = "0\r\n\r\n";
+
+    if(!generator) {
+        return returnError(HTTPC_ERROR_NO_STREAM);
+    }
+
+    if(_useHTTP10) {
+        log_w("chunked upload needs HTTP/1.1");
+        return returnError(HTTPC_ERROR_ENCODING);
+    }
+
+    // connect to server
+    if(!connect()) {
+        return returnError(HTTPC_ERROR_CONNECTION_REFUSED);
+    }
+
+    addHeader(F("Transfer-Encoding"), F("chunked"));
+
+    // send Header
+    if(!sendHeader(type)) {
+        return returnError(HTTPC_ERROR_SEND_HEADER_FAILED);
+    }
+
+    // the receive buffer is idle while the request goes out, borrow it
+    uint8_t * buff = streamBuffer();
+    if(!buff) {
+        log_d("too less ram! need %d", _streamBufferSize);
+        return returnError(HTTPC_ERROR_TOO_LESS_RAM);
+    }
+
+    // cap to what a 3 digit chunk size can describe, then align to the MSS
+    size_t frameSize = _streamBufferSize;
+    if(frameSize > 0xFFF + headRoom + tailRoom) {
+        frameSize = 0xFFF + headRoom + tailRoom;
+    }
+    if(frameSize > HTTP_TCP_BUFFER_SIZE) {
+        frameSize -= frameSize % HTTP_TCP_BUFFER_SIZE;
+    }
+    if(frameSize <= headRoom + tailRoom + sizeof(lastChunk)) {
+        log_d("stream buffer too small for chunked upload");
+        return returnError(HTTPC_ERROR_TOO_LESS_RAM);
+    }
+    size_t chunkSize = frameSize - headRoom - tailRoom;
+    uint8_t * payload = buff + headRoom;
+    size_t bytesWritten = 0;
+    bool done = false;
+
+    while(!done) {
+        if(!connected()) {
+            return returnError(HTTPC_ERROR_CONNECTION_LOST);
+        }
+
+        // coalesce generator output until the chunk is full
+        size_t fill = 0;
+        while(fill < chunkSize) {
+            size_t got = generator(payload + fill, chunkSize - fill);
+            if(got == 0) {
+                done = true;
+                break;
+            }
+            fill += (got > chunkSize - fill) ? (chunkSize - fill) : got;
+        }
+
+        size_t frameStart = headRoom;
+        size_t frameEnd = headRoom;
+        if(fill) {
+            char head[headRoom + 1];
+            int headLen = snprintf(head, sizeof(head), "%x\r\n", (unsigned int) fill);
+            frameStart = headRoom - headLen;
+            memcpy(buff + frameStart, head, headLen);
+            frameEnd = headRoom + fill;
+            buff[frameEnd++] = '\r';
+            buff[frameEnd++] = '\n';
+        }
+
+        // piggyback the last-chunk marker if it still fits
+        bool lastSent = false;
+        if(done && frameEnd + sizeof(lastChunk) - 1 <= frameSize) {
+            memcpy(buff + frameEnd, lastChunk, sizeof(lastChunk) - 1);
+            frameEnd += sizeof(lastChunk) - 1;
+            lastSent = true;
+        }
+
+        size_t frameLen = frameEnd - frameStart;
+        if(_client->write(buff + frameStart, frameLen) != frameLen) {
+            return returnError(HTTPC_ERROR_SEND_PAYLOAD_FAILED);
+        }
+        bytesWritten += fill;
+
+        if(done && !lastSent) {
+            if(_client->write((const uint8_t *) lastChunk, sizeof(lastChunk) - 1) != sizeof(lastChunk) - 1) {
+                return returnError(HTTPC_ERROR_SEND_PAYLOAD_FAILED);
+            }
+        }
+
+        delay(0);
+    }
+
+    log_d("chunked payload written: %d", bytesWritten);
+
+    // handle Server Response (Header)
+    return returnError(handleHeaderResponse());
+}
+
 /**
  * size of message body / payload
  * @return -1 if no info or > 0 when Content-Length is set by server
@@ -848,12 +1038,113 @@ int HTTPClient::writeToStream(Stream * stream)
         return returnError(HTTPC_ERROR_NOT_CONNECTED);
     }
 
+    if(_gzipBody) {
+        HTTPBodyCallback sink = [stream](const uint8_t * data, size_t len) {
+            size_t written = stream->write(data, len);
+            if(written != len) {
+                log_d("short write asked for %d but got %d retry...", len, written);
+                // reset write error for retry
+                stream->clearWriteError();
+                // some time for the stream
+                delay(1);
+                size_t left = len - written;
+                if(stream->write(data + written, left) != left) {
+                    log_w("short write asked for %d failed.", left);
+                    return false;
+                }
+            }
+            return !stream->getWriteError();
+        };
+        return readBodyInflated(sink);
+    }
+
+    return readBodyBlocks([this, stream](int len) {
+        return writeToStreamDataBlock(stream, len);
+    });
+}
+
+/**
+ * hand the message body to a callback, span by span, without copying it
+ * @param callback HTTPBodyCallback
+ * @return bytes handed to the callback ( negative values are error codes )
+ */
+int HTTPClient::readBody(HTTPBodyCallback callback)
+{
+
+    if(!callback) {
+        return returnError(HTTPC_ERROR_NO_STREAM);
+    }
+
+    if(!connected()) {
+        return returnError(HTTPC_ERROR_NOT_CONNECTED);
+    }
+
+    if(_gzipBody) {
+        return readBodyInflated(callback);
+    }
+
+    return readBodyBlocks([this, &callback](int len) {
+        return readBodyDataBlock(callback, len);
+    });
+}
+
+/**
+ * run the message body through the gzip decoder
+ * @param sink HTTPBodyCallback &   receives the decoded data
+ * @return decoded bytes ( negative values are error codes )
+ */
+int HTTPClient::readBodyInflated(HTTPBodyCallback &sink)
+{
+    std::unique_ptr<HTTPInflater> inflater(new HTTPInflater(_gzipWindow));
+    if(!inflater || inflater->begin(sink) != HTTP_INFLATE_OK) {
+        log_w("too less ram! need %d", _gzipWindow);
+        return returnError(HTTPC_ERROR_TOO_LESS_RAM);
+    }
+
+    int res = HTTP_INFLATE_OK;
+    HTTPBodyCallback feed = [&inflater, &res](const uint8_t * data, size_t len) {
+        res = inflater->write(data, len);
+        return res >= 0;
+    };
+
+    int ret = readBodyBlocks([this, &feed, &res](int len) {
+        int r = readBodyDataBlock(feed, len);
+        if(r < 0 && res < 0 && res != HTTP_INFLATE_ERROR_SINK) {
+            log_w("gzip decode error %d", res);
+            r = HTTPC_ERROR_DECODING;
+        }
+        return r;
+    });
+
+    if(ret < 0) {
+        return ret;
+    }
+
+    if(!inflater->finished()) {
+        log_w("gzip stream truncated (in: %d, out: %d)", inflater->totalIn(), inflater->totalOut());
+        return returnError(HTTPC_ERROR_DECODING);
+    }
+
+    log_d("gzip: %d bytes decoded to %d", inflater->totalIn(), inflater->totalOut());
+    return inflater->totalOut();
+}
+
+/**
+ * walk the message body, removing the chunk framing if needed
+ * @param block called for every data block with its length (-1 = until close)
+ * @return bytes handled ( negative values are error codes )
+ */
+int HTTPClient::readBodyBlocks(std::function<int(int)> block)
+{
     // get length of document (is -1 when Server sends no Content-Length header)
     int len = _size;
     int ret = 0;
 
+    memset(&_transferStats, 0, sizeof(_transferStats));
+    unsigned long transferStart = millis();
+
     if(_transferEncoding == HTTPC_TE_IDENTITY) {
-        ret = writeToStreamDataBlock(stream, len);
+        ret = block(len);
 
         // have we an error?
         if(ret < 0) {
@@ -880,9 +1171,9 @@ int HTTPClient::writeToStream(Stream * stream)
 
             // data left?
             if(len > 0) {
-                int r = writeToStreamDataBlock(stream, len);
+                int r = block(len);
                 if(r < 0) {
-                    // error in writeToStreamDataBlock
+                    // error in the data block
                     return returnError(r);
                 }
                 ret += r;
@@ -913,6 +1204,12 @@ int HTTPClient::writeToStream(Stream * stream)
         return returnError(HTTPC_ERROR_ENCODING);
     }
 
+    _transferStats.duration = millis() - transferStart;
+    if(_transferStats.duration) {
+        _transferStats.bytesPerSecond = (uint64_t) _transferStats.bytes * 1000 / _transferStats.duration;
+    }
+    log_d("transfer: %d bytes in %d ms, %d reads, %d waits", _transferStats.bytes, _transferStats.duration, _transferStats.reads, _transferStats.waits);
+
 //    end();
     disconnect(true);
     return ret;
@@ -940,6 +1237,15 @@ StreamString HTTPClient::getString(void)
     return StreamString();
 }
 
+/**
+ * statistics of the last writeToStream / getString call
+ * @return httpTransferStats_t
+ */
+const httpTransferStats_t &HTTPClient::getTransferStats(void)
+{
+    return _transferStats;
+}
+
 /**
  * converts error code to String
  * @param error int
@@ -970,6 +1276,8 @@ String HTTPClient::errorToString(int error)
         return F("Stream write error");
     case HTTPC_ERROR_READ_TIMEOUT:
         return F("read Timeout");
+    case HTTPC_ERROR_DECODING:
+        return F("Content-Encoding decode error");
     default:
         return String();
     }
@@ -989,23 +1297,32 @@ void HTTPClient::addHeader(const String& name, const String& value, bool first,
        !name.equalsIgnoreCase(F("Host")) &&
        !(name.equalsIgnoreCase(F("Authorization")) && _base64Authorization.length())){
 
-        String headerLine = name;
-        headerLine += ": ";
-
         if (replace) {
+            String headerLine = name;
+            headerLine += ": ";
             int headerStart = _headers.indexOf(headerLine);
             if (headerStart != -1 && (headerStart == 0 || _headers[headerStart - 1] == '\n')) {
                 int headerEnd = _headers.indexOf('\n', headerStart);
-                _headers = _headers.substring(0, headerStart) + _headers.substring(headerEnd + 1);
+                _headers.remove(headerStart, headerEnd + 1 - headerStart);
             }
         }
 
-        headerLine += value;
-        headerLine += "\r\n";
+        size_t lineLength = name.length() + value.length() + 4;
         if(first) {
-            _headers = headerLine + _headers;
+            String headers;
+            headers.reserve(lineLength + _headers.length());
+            headers += name;
+            headers += ": ";
+            headers += value;
+            headers += "\r\n";
+            headers += _headers;
+            _headers = headers;
         } else {
-            _headers += headerLine;
+            _headers.reserve(_headers.length() + lineLength);
+            _headers += name;
+            _headers += ": ";
+            _headers += value;
+            _headers += "\r\n";
         }
     }
 }
@@ -1122,6 +1439,34 @@ bool HTTPClient::connect(void)
  return connected();
 }
 
+/**
+ * consume the body of a redirect response so the connection can carry
+ * the next request, or mark it as not reusable if that is not possible
+ * @param type const char *   method of the request that got the response
+ */
+void HTTPClient::discardBody(const char * type)
+{
+    if(!_reuse || !_canReuse || !strcmp(type, "HEAD")) {
+        return;
+    }
+    if(_transferEncoding == HTTPC_TE_IDENTITY && _size < 0) {
+        // body ends with the connection
+        _canReuse = false;
+        return;
+    }
+    if(_transferEncoding == HTTPC_TE_IDENTITY && _size == 0) {
+        return;
+    }
+    HTTPBodyCallback discard = [](const uint8_t * data, size_t len) {
+        return true;
+    };
+    if(readBodyBlocks([this, &discard](int len) {
+        return readBodyDataBlock(discard, len);
+    }) < 0) {
+        _canReuse = false;
+    }
+}
+
 /**
  * sends HTTP request header
  * @param type (GET, POST, ...)
@@ -1133,44 +1478,75 @@ bool HTTPClient::sendHeader(const char * type)
         return false;
     }
 
-    String header = String(type) + " " + _uri + F(" HTTP/1.");
+    size_t typeLength = strlen(type);
+    size_t headersLength = _headers.length();
+    const char * cached = _headerTemplate.c_str();
 
-    if(_useHTTP10) {
-        header += "0";
-    } else {
-        header += "1";
-    }
+    // the template is "<static block><_headers>\r\n", reuse it as long as
+    // nothing in the static block changed and the user headers are the same
+    bool reuse = _headerTemplateValid &&
+                 _headerTemplate.length() == _headerTemplateStatic + headersLength + 2 &&
+                 !strncmp(cached, type, typeLength) && cached[typeLength] == ' ' &&
+                 !memcmp(cached + _headerTemplateStatic, _headers.c_str(), headersLength);
 
-    header += String(F("\r\nHost: ")) + _host;
-    if (_port != 80 && _port != 443)
-    {
-        header += ':';
-        header += String(_port);
-    }
-    header += String(F("\r\nUser-Agent: ")) + _userAgent +
-              F("\r\nConnection: ");
+    if(!reuse) {
+        String &header = _headerTemplate;
+        header = "";
+        header.reserve(typeLength + _uri.length() + _host.length() + _userAgent.length() +
+                       _base64Authorization.length() + headersLength + 160);
 
-    if(_reuse) {
-        header += F("keep-alive");
-    } else {
-        header += F("close");
-    }
-    header += "\r\n";
+        header += type;
+        header += ' ';
+        header += _uri;
+        header += F(" HTTP/1.");
 
-    if(!_useHTTP10) {
-        header += F("Accept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n");
-    }
+        if(_useHTTP10) {
+            header += "0";
+        } else {
+            header += "1";
+        }
 
-    if(_base64Authorization.length()) {
-        _base64Authorization.replace("\n", "");
-        header += F("Authorization: Basic ");
-        header += _base64Authorization;
+        header += F("\r\nHost: ");
+        header += _host;
+        if (_port != 80 && _port != 443)
+        {
+            header += ':';
+            header += String(_port);
+        }
+        header += F("\r\nUser-Agent: ");
+        header += _userAgent;
+        header += F("\r\nConnection: ");
+
+        if(_reuse) {
+            header += F("keep-alive");
+        } else {
+            header += F("close");
+        }
         header += "\r\n";
-    }
 
-    header += _headers + "\r\n";
+        if(!_useHTTP10) {
+            if(_acceptGzip) {
+                header += F("Accept-Encoding: gzip;q=1,identity;q=0.5,*;q=0\r\n");
+            } else {
+                header += F("Accept-Encoding: identity;q=1,chunked;q=0.1,*;q=0\r\n");
+            }
+        }
+
+        if(_base64Authorization.length()) {
+            header += F("Authorization: Basic ");
+            header += _base64Authorization;
+            header += "\r\n";
+        }
+
+        _headerTemplateStatic = header.length();
+        header += _headers;
+        header += "\r\n";
+        _headerTemplateValid = true;
+    } else {
+        log_v("reusing request header template");
+    }
 
-    return (_client->write((const uint8_t *) header.c_str(), header.length()) == header.length());
+    return (_client->write((const uint8_t *) _headerTemplate.c_str(), _headerTemplate.length()) == _headerTemplate.length());
 }
 
 /**
@@ -1191,6 +1567,7 @@ int HTTPClient::handleHeaderResponse()
     String transferEncoding;
 
     _transferEncoding = HTTPC_TE_IDENTITY;
+    _gzipBody = false;
     unsigned long lastDataTime = millis();
     bool firstLine = true;
 
@@ -1230,6 +1607,10 @@ int HTTPClient::handleHeaderResponse()
                     transferEncoding = headerValue;
                 }
 
+                if(_acceptGzip && headerName.equalsIgnoreCase("Content-Encoding")) {
+                    _gzipBody = headerValue.equalsIgnoreCase("gzip") || headerValue.equalsIgnoreCase("x-gzip");
+                }
+
                 if (headerName.equalsIgnoreCase("Location")) {
                     _location = headerValue;
                 }
@@ -1279,6 +1660,31 @@ int HTTPClient::handleHeaderResponse()
     return HTTPC_ERROR_CONNECTION_LOST;
 }
 
+/**
+ * returns the receive buffer, the pooled one is allocated on first use
+ * @return uint8_t * or nullptr if out of memory
+ */
+uint8_t * HTTPClient::streamBuffer(void)
+{
+    if(!_streamBuffer) {
+        _streamBuffer = (uint8_t *) malloc(_streamBufferSize);
+        _streamBufferOwned = (_streamBuffer != nullptr);
+    }
+    return _streamBuffer;
+}
+
+/**
+ * release the pooled receive buffer, forget a caller-supplied one
+ */
+void HTTPClient::freeStreamBuffer(void)
+{
+    if(_streamBufferOwned) {
+        free(_streamBuffer);
+    }
+    _streamBuffer = nullptr;
+    _streamBufferOwned = false;
+}
+
 /**
  * write one Data Block to Stream
  * @param stream Stream *
@@ -1287,98 +1693,92 @@ int HTTPClient::handleHeaderResponse()
  */
 int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
 {
-    int buff_size = HTTP_TCP_BUFFER_SIZE;
     int len = size;
     int bytesWritten = 0;
 
-    // if possible create smaller buffer then HTTP_TCP_BUFFER_SIZE
-    if((len > 0) && (len < HTTP_TCP_BUFFER_SIZE)) {
-        buff_size = len;
-    }
-
-    // create buffer for read
-    uint8_t * buff = (uint8_t *) malloc(buff_size);
+    // get the receive buffer (reused between calls)
+    uint8_t * buff = streamBuffer();
 
     if(buff) {
+        int buff_size = _streamBufferSize;
+        unsigned long lastDataTime = millis();
+
         // read all data from server
         while(connected() && (len > 0 || len == -1)) {
 
-            // get available data size
-            size_t sizeAvailable = _client->available();
+            int readBytes = buff_size;
 
-            if(sizeAvailable) {
+            // read only the asked bytes
+            if(len > 0 && readBytes > len) {
+                readBytes = len;
+            }
 
-                int readBytes = sizeAvailable;
+            // take as much as the client can hand out, up to one buffer
+            int bytesRead = _client->read(buff, readBytes);
 
-                // read only the asked bytes
-                if(len > 0 && readBytes > len) {
-                    readBytes = len;
+            if(bytesRead <= 0) {
+                unsigned long waited = millis() - lastDataTime;
+                if(waited >= _tcpTimeout) {
+                    // without Content-Length only the close ends the body
+                    log_w("read timeout (written: %d).", bytesWritten);
+                    return HTTPC_ERROR_READ_TIMEOUT;
                 }
+                // sleep on the socket instead of polling
+                _transferStats.waits++;
+                _client->waitAvailable(_tcpTimeout - waited);
+                continue;
+            }
 
-                // not read more the buffer can handle
-                if(readBytes > buff_size) {
-                    readBytes = buff_size;
-                }
-		    
-		// stop if no more reading    
-		if (readBytes == 0)
-			break;
-
-                // read data
-                int bytesRead = _client->readBytes(buff, readBytes);
-
-                // write it to Stream
-                int bytesWrite = stream->write(buff, bytesRead);
-                bytesWritten += bytesWrite;
+            lastDataTime = millis();
+            _transferStats.reads++;
 
-                // are all Bytes a writen to stream ?
-                if(bytesWrite != bytesRead) {
-                    log_d("short write asked for %d but got %d retry...", bytesRead, bytesWrite);
+            // write it to Stream
+            int bytesWrite = stream->write(buff, bytesRead);
+            bytesWritten += bytesWrite;
 
-                    // check for write error
-                    if(stream->getWriteError()) {
-                        log_d("stream write error %d", stream->getWriteError());
+            // are all Bytes a writen to stream ?
+            if(bytesWrite != bytesRead) {
+                log_d("short write asked for %d but got %d retry...", bytesRead, bytesWrite);
 
-                        //reset write error for retry
-                        stream->clearWriteError();
-                    }
+                // check for write error
+                if(stream->getWriteError()) {
+                    log_d("stream write error %d", stream->getWriteError());
 
-                    // some time for the stream
-                    delay(1);
+                    //reset write error for retry
+                    stream->clearWriteError();
+                }
 
-                    int leftBytes = (readBytes - bytesWrite);
+                // some time for the stream
+                delay(1);
 
-                    // retry to send the missed bytes
-                    bytesWrite = stream->write((buff + bytesWrite), leftBytes);
-                    bytesWritten += bytesWrite;
+                int leftBytes = (bytesRead - bytesWrite);
 
-                    if(bytesWrite != leftBytes) {
-                        // failed again
-                        log_w("short write asked for %d but got %d failed.", leftBytes, bytesWrite);
-                        free(buff);
-                        return HTTPC_ERROR_STREAM_WRITE;
-                    }
-                }
+                // retry to send the missed bytes
+                bytesWrite = stream->write((buff + bytesWrite), leftBytes);
+                bytesWritten += bytesWrite;
 
-                // check for write error
-                if(stream->getWriteError()) {
-                    log_w("stream write error %d", stream->getWriteError());
-                    free(buff);
+                if(bytesWrite != leftBytes) {
+                    // failed again
+                    log_w("short write asked for %d but got %d failed.", leftBytes, bytesWrite);
                     return HTTPC_ERROR_STREAM_WRITE;
                 }
+            }
 
-                // count bytes to read left
-                if(len > 0) {
-                    len -= readBytes;
-                }
+            // check for write error
+            if(stream->getWriteError()) {
+                log_w("stream write error %d", stream->getWriteError());
+                return HTTPC_ERROR_STREAM_WRITE;
+            }
 
-                delay(0);
-            } else {
-                delay(1);
+            _transferStats.bytes += bytesRead;
+
+            // count bytes to read left
+            if(len > 0) {
+                len -= bytesRead;
             }
-        }
 
-        free(buff);
+            delay(0);
+        }
 
         log_d("connection closed or file end (written: %d).", bytesWritten);
 
@@ -1388,13 +1788,80 @@ int HTTPClient::writeToStreamDataBlock(Stream * stream, int size)
         }
 
     } else {
-        log_w("too less ram! need %d", HTTP_TCP_BUFFER_SIZE);
+        log_w("too less ram! need %d", _streamBufferSize);
         return HTTPC_ERROR_TOO_LESS_RAM;
     }
 
     return bytesWritten;
 }
 
+/**
+ * hand one Data Block to the body callback
+ * @param callback HTTPBodyCallback &
+ * @param size int
+ * @return < 0 = error >= 0 = size handled
+ */
+int HTTPClient::readBodyDataBlock(HTTPBodyCallback &callback, int size)
+{
+    int len = size;
+    int bytesHandled = 0;
+    unsigned long lastDataTime = millis();
+
+    while(connected() && (len > 0 || len == -1)) {
+
+        size_t sizeAvailable = _client->peekAvailable();
+
+        if(!sizeAvailable) {
+            unsigned long waited = millis() - lastDataTime;
+            if(waited >= _tcpTimeout) {
+                // without Content-Length only the close ends the body
+                log_w("read timeout (handled: %d).", bytesHandled);
+                return HTTPC_ERROR_READ_TIMEOUT;
+            }
+            _transferStats.waits++;
+            _client->waitAvailable(_tcpTimeout - waited);
+            continue;
+        }
+
+        const uint8_t * data = _client->peekBuffer();
+        if(!data) {
+            return HTTPC_ERROR_CONNECTION_LOST;
+        }
+
+        // hand out only the asked bytes
+        if(len > 0 && sizeAvailable > (size_t) len) {
+            sizeAvailable = len;
+        }
+
+        lastDataTime = millis();
+        _transferStats.reads++;
+
+        bool more = callback(data, sizeAvailable);
+        _client->peekConsume(sizeAvailable);
+
+        bytesHandled += sizeAvailable;
+        _transferStats.bytes += sizeAvailable;
+
+        if(len > 0) {
+            len -= sizeAvailable;
+        }
+
+        if(!more) {
+            log_d("body callback aborted (handled: %d).", bytesHandled);
+            return HTTPC_ERROR_STREAM_WRITE;
+        }
+
+        delay(0);
+    }
+
+    if((size > 0) && (size != bytesHandled)) {
+        log_d("bytesHandled %d and size %d mismatch!.", bytesHandled, size);
+        return HTTPC_ERROR_STREAM_WRITE;
+    }
+
+    return bytesHandled;
+}
+
 /**
  * called to handle error return, may disconnect the connection if still exists
  * @param error
@@ -1422,38 +1889,62 @@ void HTTPClient::setRedirectLimit(uint16_t limit)
     _redirectLimit = limit;
 }
 
+/**
+ * statistics of the redirects followed by the last sendRequest
+ * @return httpRedirectStats_t
+ */
+const httpRedirectStats_t &HTTPClient::getRedirectStats(void)
+{
+    return _redirectStats;
+}
+
 /**
  * set the URL to a new value. Handy for following redirects.
  * @param url
  */
 bool HTTPClient::setURL(const String& url)
 {
+    // the open connection can carry the next request if the server allowed
+    // keep-alive and the target stays the same
+    bool keep = _reuse && _canReuse;
+    String oldHost = _host;
+    uint16_t oldPort = _port;
+
     // if the new location is only a path then only update the URI
     if (url && url[0] == '/') {
         _uri = url;
+        _headerTemplateValid = false;
         clear();
-        return true;
-    }
+    } else {
+        if (!url.startsWith(_protocol + ':')) {
+            log_d("new URL not the same protocol, expected '%s', URL: '%s'\n", _protocol.c_str(), url.c_str());
+            return false;
+        }
 
-    if (!url.startsWith(_protocol + ':')) {
-        log_d("new URL not the same protocol, expected '%s', URL: '%s'\n", _protocol.c_str(), url.c_str());
-        return false;
-    }
+        // check if the port is specified
+        int indexPort = url.indexOf(':', 6); // find the first ':' excluding the one from the protocol
+        int indexURI = url.indexOf('/', 7); // find where the URI starts to make sure the ':' is not part of it
+        if (indexPort == -1 || indexPort > indexURI) {
+            // the port is not specified
+            _port = (_protocol == "https" ? 443 : 80);
+        }
 
-    // check if the port is specified
-    int indexPort = url.indexOf(':', 6); // find the first ':' excluding the one from the protocol
-    int indexURI = url.indexOf('/', 7); // find where the URI starts to make sure the ':' is not part of it
-    if (indexPort == -1 || indexPort > indexURI) {
-        // the port is not specified
-        _port = (_protocol == "https" ? 443 : 80);
+        if (!beginInternal(url, _protocol.c_str())) {
+            return false;
+        }
     }
 
-    // disconnect but preserve _client. 
-    // Also have to keep the connection otherwise it will free some of the memory used by _client 
-    // and will blow up later when trying to do _client->available() or similar
-    _canReuse = true;
-    disconnect(true);
-    return beginInternal(url, _protocol.c_str());
+    if (keep && _port == oldPort && _host.equalsIgnoreCase(oldHost)) {
+        log_d("redirect to the same host, keeping the connection\n");
+        _redirectStats.reused++;
+    } else if (_client && _client->connected()) {
+        // only close the socket: _client (and for the deprecated api the
+        // transport that owns it) is needed again by connect()
+        log_d("redirect to another host, closing the connection\n");
+        _client->stop();
+    }
+    _canReuse = keep;
+    return true;
 }
 
 const String &HTTPClient::getLocation(void)
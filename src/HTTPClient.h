@@ -30,6 +30,7 @@
 #define HTTPCLIENT_1_1_COMPATIBLE
 
 #include <memory>
+#include <functional>
 #include <Arduino.h>
 #include <rpcWiFi.h>
 #include <WiFiClient.h>
@@ -50,10 +51,14 @@
 #define HTTPC_ERROR_ENCODING            (-9)
 #define HTTPC_ERROR_STREAM_WRITE        (-10)
 #define HTTPC_ERROR_READ_TIMEOUT        (-11)
+#define HTTPC_ERROR_DECODING            (-12)
 
 /// size for the stream handling
 #define HTTP_TCP_BUFFER_SIZE (1460)
 
+/// default history window for gzip decoding, enough for any deflate stream
+#define HTTPC_GZIP_WINDOW_SIZE (32768)
+
 /// HTTP codes see RFC7231
 typedef enum {
     HTTP_CODE_CONTINUE = 100,
@@ -116,6 +121,22 @@ typedef enum {
     HTTP_CODE_NETWORK_AUTHENTICATION_REQUIRED = 511
 } t_http_codes;
 
+/// statistics of the last body transfer (writeToStream / getString)
+typedef struct {
+    size_t bytes;            // payload bytes written to the destination stream
+    uint32_t duration;       // ms spent in the transfer
+    uint32_t reads;          // read calls that returned data
+    uint32_t waits;          // times the client had no data and waited on the socket
+    uint32_t bytesPerSecond; // average throughput, 0 if duration is 0
+} httpTransferStats_t;
+
+/// statistics of the redirect chain followed by the last sendRequest
+typedef struct {
+    uint16_t redirects;   // redirects followed
+    uint16_t reused;      // redirects that kept the open connection
+    uint32_t latency;     // ms from the first redirect response to the final response
+} httpRedirectStats_t;
+
 typedef enum {
     HTTPC_TE_IDENTITY,
     HTTPC_TE_CHUNKED
@@ -139,6 +160,21 @@ typedef enum {
 } followRedirects_t;
 
 
+/**
+ * body consumer for HTTPClient::readBody.
+ * gets consecutive spans of the message body straight from the receive
+ * buffer, chunk framing already removed. The data is only valid during
+ * the call. Return false to abort the transfer.
+ */
+typedef std::function<bool(const uint8_t * data, size_t len)> HTTPBodyCallback;
+
+/**
+ * body producer for HTTPClient::sendChunkedRequest.
+ * fills up to maxLen bytes into buffer and returns how many were written,
+ * 0 marks the end of the body.
+ */
+typedef std::function<size_t(uint8_t * buffer, size_t maxLen)> HTTPBodyGenerator;
+
 #ifdef HTTPCLIENT_1_1_COMPATIBLE
 class TransportTraits;
 typedef std::unique_ptr<TransportTraits> TransportTraitsPtr;
@@ -176,9 +212,18 @@ public:
     void setConnectTimeout(int32_t connectTimeout);
     void setTimeout(uint16_t timeout);
 
+    // Receive buffer used by writeToStream / getString
+    void setStreamBuffer(uint8_t * buffer, size_t size); // caller-supplied, must outlive the HTTPClient
+    void setStreamBufferSize(size_t size);               // pooled, allocated on first use
+
+    // gzip response bodies, decoded by writeToStream / getString / readBody
+    // (getStream still returns the raw connection)
+    void setAcceptGzip(bool gzip, size_t window = HTTPC_GZIP_WINDOW_SIZE);
+
     // Redirections
     void setFollowRedirects(followRedirects_t follow);
     void setRedirectLimit(uint16_t limit); // max redirects to follow for a single request
+    const httpRedirectStats_t &getRedirectStats(void);
 
     bool setURL(const String &url);
     void useHTTP10(bool usehttp10 = true);
@@ -194,6 +239,7 @@ public:
     int sendRequest(const char * type, String payload);
     int sendRequest(const char * type, uint8_t * payload = NULL, size_t size = 0);
     int sendRequest(const char * type, Stream * stream, size_t size = 0);
+    int sendChunkedRequest(const char * type, HTTPBodyGenerator generator);
 
     void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
 
@@ -212,7 +258,9 @@ public:
     WiFiClient& getStream(void);
     WiFiClient* getStreamPtr(void);
     int writeToStream(Stream* stream);
+    int readBody(HTTPBodyCallback callback);
     StreamString getString(void);
+    const httpTransferStats_t &getTransferStats(void);
 
     static String errorToString(int error);
 
@@ -227,9 +275,15 @@ protected:
     void clear();
     int returnError(int error);
     bool connect(void);
+    void discardBody(const char * type);
     bool sendHeader(const char * type);
     int handleHeaderResponse();
+    int readBodyBlocks(std::function<int(int)> block);
     int writeToStreamDataBlock(Stream * stream, int len);
+    int readBodyDataBlock(HTTPBodyCallback &callback, int len);
+    int readBodyInflated(HTTPBodyCallback &sink);
+    uint8_t * streamBuffer(void);
+    void freeStreamBuffer(void);
 
 
 #ifdef HTTPCLIENT_1_1_COMPATIBLE
@@ -265,6 +319,23 @@ protected:
     uint16_t _redirectLimit = 10;
     String _location;
     transferEncoding_t _transferEncoding = HTTPC_TE_IDENTITY;
+    httpRedirectStats_t _redirectStats = {};
+
+    /// stream receive buffer
+    uint8_t * _streamBuffer = nullptr;
+    size_t _streamBufferSize = HTTP_TCP_BUFFER_SIZE;
+    bool _streamBufferOwned = false;
+    httpTransferStats_t _transferStats = {};
+
+    /// gzip content decoding
+    bool _acceptGzip = false;
+    size_t _gzipWindow = HTTPC_GZIP_WINDOW_SIZE;
+    bool _gzipBody = false;
+
+    /// serialized request header, rebuilt only when its inputs change
+    String _headerTemplate;
+    size_t _headerTemplateStatic = 0;
+    bool _headerTemplateValid = false;
 };
 
 
@@ -0,0 +1,527 @@
+/*
+  HTTPInflater.cpp - streaming gzip decoder for HTTPClient
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "HTTPInflater.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define GZIP_FHCRC    (0x02)
+#define GZIP_FEXTRA   (0x04)
+#define GZIP_FNAME    (0x08)
+#define GZIP_FCOMMENT (0x10)
+
+static const uint16_t lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577};
+static const uint8_t distanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t codeLengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+static const uint32_t crcTable[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+HTTPInflater::HTTPInflater(size_t windowSize)
+    : _window(NULL), _windowSize(windowSize), _state(stError)
+{
+    _lit.symbol = _litSymbol;
+    _dist.symbol = _distSymbol;
+}
+
+HTTPInflater::~HTTPInflater()
+{
+    free(_window);
+}
+
+/**
+ * reset the decoder for a new gzip stream
+ * @param sink HTTPInflateSink    receiver of the decompressed data
+ * @return HTTP_INFLATE_OK or HTTP_INFLATE_ERROR_MEMORY
+ */
+int HTTPInflater::begin(HTTPInflateSink sink)
+{
+    if (!_window)
+    {
+        _window = (uint8_t *)malloc(_windowSize);
+        if (!_window)
+        {
+            _state = stError;
+            return HTTP_INFLATE_ERROR_MEMORY;
+        }
+    }
+    _sink = sink;
+    _wpos = 0;
+    _flushPos = 0;
+    _bitbuf = 0;
+    _bitcount = 0;
+    _state = stHeader;
+    _last = false;
+    _crc = 0;
+    _totalIn = 0;
+    _totalOut = 0;
+    return HTTP_INFLATE_OK;
+}
+
+/**
+ * push compressed data into the decoder
+ * @param data const uint8_t *
+ * @param len size_t
+ * @return HTTP_INFLATE_OK if more data is expected, HTTP_INFLATE_DONE at the end of the stream, < 0 on error
+ */
+int HTTPInflater::write(const uint8_t *data, size_t len)
+{
+    if (_state == stError)
+    {
+        return HTTP_INFLATE_ERROR_FORMAT;
+    }
+    _in = data;
+    _inEnd = data + len;
+    _totalIn += len;
+
+    int res = HTTP_INFLATE_OK;
+    while (_state != stDone)
+    {
+        refill();
+        res = step();
+        if (res < 0)
+        {
+            break;
+        }
+        if (res == 0 && _in == _inEnd)
+        {
+            // wait for more input
+            break;
+        }
+        res = HTTP_INFLATE_OK;
+    }
+
+    if (res >= 0 && _state != stError && !flush())
+    {
+        res = HTTP_INFLATE_ERROR_SINK;
+    }
+    if (res < 0)
+    {
+        _state = stError;
+        return res;
+    }
+    // data following the trailer (e.g. a second member) is ignored
+    if (_state == stDone)
+    {
+        _totalIn -= (_inEnd - _in) + _bitcount / 8;
+    }
+    return _state == stDone ? HTTP_INFLATE_DONE : HTTP_INFLATE_OK;
+}
+
+void HTTPInflater::refill()
+{
+    while (_bitcount <= 56 && _in < _inEnd)
+    {
+        _bitbuf |= (uint64_t)(*_in++) << _bitcount;
+        _bitcount += 8;
+    }
+}
+
+bool HTTPInflater::flush()
+{
+    if (_wpos == _flushPos)
+    {
+        return true;
+    }
+    uint32_t crc = ~_crc;
+    for (size_t i = _flushPos; i < _wpos; i++)
+    {
+        crc ^= _window[i];
+        crc = (crc >> 4) ^ crcTable[crc & 15];
+        crc = (crc >> 4) ^ crcTable[crc & 15];
+    }
+    _crc = ~crc;
+    bool res = _sink(_window + _flushPos, _wpos - _flushPos);
+    _flushPos = _wpos;
+    return res;
+}
+
+bool HTTPInflater::put(uint8_t c)
+{
+    _window[_wpos++] = c;
+    _totalOut++;
+    if (_wpos == _windowSize)
+    {
+        if (!flush())
+        {
+            return false;
+        }
+        _wpos = 0;
+        _flushPos = 0;
+    }
+    return true;
+}
+
+/**
+ * build a canonical huffman decoding table
+ * @return false if the code lengths are over-subscribed
+ */
+bool HTTPInflater::build(Huffman &h, const uint8_t *length, int n)
+{
+    uint16_t offs[16];
+    memset(h.count, 0, sizeof(h.count));
+    for (int sym = 0; sym < n; sym++)
+    {
+        h.count[length[sym]]++;
+    }
+    int left = 1;
+    for (int len = 1; len < 16; len++)
+    {
+        left <<= 1;
+        left -= h.count[len];
+        if (left < 0)
+        {
+            return false;
+        }
+    }
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++)
+    {
+        offs[len + 1] = offs[len] + h.count[len];
+    }
+    for (int sym = 0; sym < n; sym++)
+    {
+        if (length[sym])
+        {
+            h.symbol[offs[length[sym]]++] = sym;
+        }
+    }
+    return true;
+}
+
+/**
+ * decode one symbol without consuming it
+ * @return code length in bits, 0 if more bits are needed, -1 on invalid code
+ */
+int HTTPInflater::decode(const Huffman &h, int &sym)
+{
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++)
+    {
+        if (len > _bitcount)
+        {
+            return 0;
+        }
+        code |= (_bitbuf >> (len - 1)) & 1;
+        int count = h.count[len];
+        if (code - count < first)
+        {
+            sym = h.symbol[index + (code - first)];
+            return len;
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+/**
+ * run one unit of work of the state machine
+ * @return > 0 progress made, 0 more input needed, < 0 error
+ */
+int HTTPInflater::step()
+{
+    int sym, len;
+
+    switch (_state)
+    {
+    case stHeader:
+        if (!need(32))
+            return 0;
+        if (take(8) != 0x1f || take(8) != 0x8b || take(8) != 8)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        _flags = take(8);
+        _state = stHeaderRest;
+        return 1;
+
+    case stHeaderRest:
+        // MTIME, XFL, OS
+        if (!need(48))
+            return 0;
+        drop(48);
+        _state = stExtraLen;
+        return 1;
+
+    case stExtraLen:
+        if (!(_flags & GZIP_FEXTRA))
+        {
+            _state = stName;
+            return 1;
+        }
+        if (!need(16))
+            return 0;
+        _remaining = take(16);
+        _state = stExtra;
+        return 1;
+
+    case stExtra:
+        if (!_remaining)
+        {
+            _state = stName;
+            return 1;
+        }
+        if (!need(8))
+            return 0;
+        drop(8);
+        _remaining--;
+        return 1;
+
+    case stName:
+    case stComment:
+        if (!(_flags & (_state == stName ? GZIP_FNAME : GZIP_FCOMMENT)))
+        {
+            _state = (_state == stName) ? stComment : stHeaderCrc;
+            return 1;
+        }
+        if (!need(8))
+            return 0;
+        if (take(8) == 0)
+        {
+            _state = (_state == stName) ? stComment : stHeaderCrc;
+        }
+        return 1;
+
+    case stHeaderCrc:
+        if (_flags & GZIP_FHCRC)
+        {
+            if (!need(16))
+                return 0;
+            drop(16);
+        }
+        _state = stBlock;
+        return 1;
+
+    case stBlock:
+        if (_last)
+        {
+            _state = stTrailer;
+            return 1;
+        }
+        if (!need(3))
+            return 0;
+        _last = take(1);
+        switch (take(2))
+        {
+        case 0:
+            _state = stStoredLen;
+            break;
+        case 1:
+        {
+            uint8_t *l = _lengths;
+            memset(l, 8, 144);
+            memset(l + 144, 9, 112);
+            memset(l + 256, 7, 24);
+            memset(l + 280, 8, 8);
+            build(_lit, l, 288);
+            memset(l, 5, 30);
+            build(_dist, l, 30);
+            _state = stCodes;
+            break;
+        }
+        case 2:
+            _state = stDynamic;
+            break;
+        default:
+            return HTTP_INFLATE_ERROR_FORMAT;
+        }
+        return 1;
+
+    case stStoredLen:
+        drop(_bitcount & 7);
+        if (!need(32))
+            return 0;
+        _remaining = take(16);
+        if ((take(16) ^ 0xffff) != _remaining)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        _state = stStored;
+        return 1;
+
+    case stStored:
+        while (_remaining && need(8))
+        {
+            if (!put(take(8)))
+                return HTTP_INFLATE_ERROR_SINK;
+            _remaining--;
+            refill();
+        }
+        if (_remaining)
+            return 0;
+        _state = stBlock;
+        return 1;
+
+    case stDynamic:
+        if (!need(14))
+            return 0;
+        _nlen = take(5) + 257;
+        _ndist = take(5) + 1;
+        _ncode = take(4) + 4;
+        if (_nlen > 286 || _ndist > 30)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        memset(_lengths, 0, 19);
+        _index = 0;
+        _state = stCodeLengths;
+        return 1;
+
+    case stCodeLengths:
+        while (_index < _ncode && need(3))
+        {
+            _lengths[codeLengthOrder[_index++]] = take(3);
+        }
+        if (_index < _ncode)
+            return 0;
+        // the code length code lives in the distance table until the lengths are read
+        if (!build(_dist, _lengths, 19))
+            return HTTP_INFLATE_ERROR_FORMAT;
+        _index = 0;
+        _state = stLengths;
+        return 1;
+
+    case stLengths:
+        while (_index < _nlen + _ndist)
+        {
+            len = decode(_dist, sym);
+            if (len < 0)
+                return HTTP_INFLATE_ERROR_FORMAT;
+            if (len == 0)
+                return 0;
+            if (sym < 16)
+            {
+                drop(len);
+                _lengths[_index++] = sym;
+                continue;
+            }
+            uint8_t extra = (sym == 16) ? 2 : (sym == 17) ? 3 : 7;
+            if (!need(len + extra))
+                return 0;
+            drop(len);
+            uint32_t repeat = take(extra) + ((sym == 16) ? 3 : (sym == 17) ? 3 : 11);
+            uint8_t value = 0;
+            if (sym == 16)
+            {
+                if (_index == 0)
+                    return HTTP_INFLATE_ERROR_FORMAT;
+                value = _lengths[_index - 1];
+            }
+            if (_index + repeat > (uint32_t)(_nlen + _ndist))
+                return HTTP_INFLATE_ERROR_FORMAT;
+            while (repeat--)
+            {
+                _lengths[_index++] = value;
+            }
+        }
+        if (_lengths[256] == 0)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        if (!build(_lit, _lengths, _nlen) || !build(_dist, _lengths + _nlen, _ndist))
+            return HTTP_INFLATE_ERROR_FORMAT;
+        _state = stCodes;
+        return 1;
+
+    case stCodes:
+        len = decode(_lit, sym);
+        if (len < 0)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        if (len == 0)
+            return 0;
+        if (sym < 256)
+        {
+            drop(len);
+            return put(sym) ? 1 : HTTP_INFLATE_ERROR_SINK;
+        }
+        if (sym == 256)
+        {
+            drop(len);
+            _state = stBlock;
+            return 1;
+        }
+        sym -= 257;
+        if (sym >= 29)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        if (!need(len + lengthExtra[sym]))
+            return 0;
+        drop(len);
+        _length = lengthBase[sym] + take(lengthExtra[sym]);
+        _state = stDistance;
+        return 1;
+
+    case stDistance:
+        len = decode(_dist, sym);
+        if (len < 0)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        if (len == 0)
+            return 0;
+        if (sym >= 30)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        if (!need(len + distanceExtra[sym]))
+            return 0;
+        drop(len);
+        _distance = distanceBase[sym] + take(distanceExtra[sym]);
+        if (_distance > _windowSize)
+            return HTTP_INFLATE_ERROR_WINDOW;
+        if (_distance > _totalOut)
+            return HTTP_INFLATE_ERROR_FORMAT;
+        _state = stCopy;
+        return 1;
+
+    case stCopy:
+        while (_length)
+        {
+            size_t from = (_wpos >= _distance) ? (_wpos - _distance) : (_wpos + _windowSize - _distance);
+            if (!put(_window[from]))
+                return HTTP_INFLATE_ERROR_SINK;
+            _length--;
+        }
+        _state = stCodes;
+        return 1;
+
+    case stTrailer:
+        drop(_bitcount & 7);
+        if (!need(32))
+            return 0;
+        if (!flush())
+            return HTTP_INFLATE_ERROR_SINK;
+        if (take(32) != _crc)
+            return HTTP_INFLATE_ERROR_CHECKSUM;
+        _state = stTrailerSize;
+        return 1;
+
+    case stTrailerSize:
+        if (!need(32))
+            return 0;
+        if (take(32) != (uint32_t)_totalOut)
+            return HTTP_INFLATE_ERROR_CHECKSUM;
+        _state = stDone;
+        return 1;
+
+    default:
+        return HTTP_INFLATE_ERROR_FORMAT;
+    }
+}
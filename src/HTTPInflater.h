@@ -0,0 +1,113 @@
+/*
+  HTTPInflater.h - streaming gzip decoder for HTTPClient
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _HTTPINFLATER_H_
+#define _HTTPINFLATER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+
+/// receives decompressed data, return false to abort
+typedef std::function<bool(const uint8_t *data, size_t len)> HTTPInflateSink;
+
+typedef enum {
+    HTTP_INFLATE_OK = 0,
+    HTTP_INFLATE_DONE = 1,
+    HTTP_INFLATE_ERROR_FORMAT = -1,     // not gzip/deflate or corrupt stream
+    HTTP_INFLATE_ERROR_WINDOW = -2,     // back-reference further than the configured window
+    HTTP_INFLATE_ERROR_CHECKSUM = -3,   // CRC32 or size in the gzip trailer does not match
+    HTTP_INFLATE_ERROR_SINK = -4,       // sink refused the data
+    HTTP_INFLATE_ERROR_MEMORY = -5      // window could not be allocated
+} httpInflateResult_t;
+
+/**
+ * streaming gzip (RFC1952 / RFC1951) decoder.
+ * compressed data can be pushed in pieces of any size, decompressed data
+ * is handed to the sink in spans straight out of the window buffer.
+ * The window bounds the memory use: streams referencing data further
+ * back than the window fail with HTTP_INFLATE_ERROR_WINDOW (32768 is always enough).
+ */
+class HTTPInflater
+{
+public:
+    HTTPInflater(size_t windowSize = 32768);
+    ~HTTPInflater();
+
+    int begin(HTTPInflateSink sink);
+    int write(const uint8_t *data, size_t len);
+    bool finished() const { return _state == stDone; }
+    size_t totalIn() const { return _totalIn; }
+    size_t totalOut() const { return _totalOut; }
+
+private:
+    enum state
+    {
+        stHeader, stHeaderRest, stExtraLen, stExtra, stName, stComment, stHeaderCrc,
+        stBlock, stStoredLen, stStored, stDynamic, stCodeLengths, stLengths,
+        stCodes, stDistance, stCopy, stTrailer, stTrailerSize, stDone, stError
+    };
+
+    struct Huffman
+    {
+        uint16_t count[16];
+        uint16_t *symbol;
+    };
+
+    int step();
+    bool build(Huffman &h, const uint8_t *length, int n);
+    int decode(const Huffman &h, int &sym);
+    bool put(uint8_t c);
+    bool flush();
+
+    void refill();
+    bool need(uint8_t n) { return _bitcount >= n; }
+    uint32_t bits(uint8_t n) const { return (uint32_t)(_bitbuf & ((1ULL << n) - 1)); }
+    void drop(uint8_t n) { _bitbuf >>= n; _bitcount -= n; }
+    uint32_t take(uint8_t n) { uint32_t v = bits(n); drop(n); return v; }
+
+    HTTPInflateSink _sink;
+    uint8_t *_window;
+    size_t _windowSize;
+    size_t _wpos;
+    size_t _flushPos;
+
+    const uint8_t *_in;
+    const uint8_t *_inEnd;
+    uint64_t _bitbuf;
+    uint8_t _bitcount;
+
+    state _state;
+    uint8_t _flags;
+    bool _last;
+    uint32_t _remaining;
+    uint32_t _length;
+    uint32_t _distance;
+    uint32_t _crc;
+    size_t _totalIn;
+    size_t _totalOut;
+
+    uint16_t _nlen, _ndist, _ncode, _index;
+    uint8_t _lengths[320];
+    uint16_t _litSymbol[288];
+    uint16_t _distSymbol[30];
+    Huffman _lit;
+    Huffman _dist;
+};
+
+#endif
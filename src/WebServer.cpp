@@ -82,6 +82,8 @@ WebServer::WebServer(int port)
 }
 
 WebServer::~WebServer() {
+  _useReactor = false;
+  _updateReactor();
   _server.close();
   if (_currentHeaders)
     delete[]_currentHeaders;
@@ -97,12 +99,53 @@ void WebServer::begin() {
   close();
   _server.begin();
   _server.setNoDelay(true);
+  _updateReactor();
 }
 
 void WebServer::begin(uint16_t port) {
   close();
   _server.begin(port);
   _server.setNoDelay(true);
+  _updateReactor();
+}
+
+void WebServer::useReactor(bool enable) {
+  _useReactor = enable;
+  _updateReactor();
+}
+
+// register the sockets handleClient() is waiting for: the listening socket
+// while idle, the current client and its timeout while serving it
+void WebServer::_updateReactor() {
+  int serverFd = _server.fd();
+  int clientFd = (_useReactor && _currentStatus != HC_NONE) ? _currentClient.fd() : -1;
+
+  if (_reactorClientFd >= 0 && _reactorClientFd != clientFd) {
+    WiFiReactor.remove(_reactorClientFd);
+    _reactorClientFd = -1;
+  }
+  if (serverFd < 0) {
+    return;
+  }
+  if (!_useReactor) {
+    WiFiReactor.remove(serverFd);
+    return;
+  }
+
+  WiFiReactor.add(serverFd, clientFd < 0 ? WIFI_REACTOR_READ : 0, [this](int fd, uint8_t events) {
+    handleClient();
+  });
+  // connections already accepted into the server queue do not make the socket readable
+  WiFiReactor.setDeadline(serverFd, (clientFd < 0 && _server.pending()) ? 1 : 0);
+  if (clientFd >= 0) {
+    WiFiReactor.add(clientFd, WIFI_REACTOR_READ, [this](int fd, uint8_t events) {
+      handleClient();
+    });
+    _reactorClientFd = clientFd;
+    uint32_t wait = (_currentStatus == HC_WAIT_READ) ? HTTP_MAX_DATA_WAIT : HTTP_MAX_CLOSE_WAIT;
+    uint32_t elapsed = millis() - _statusChange;
+    WiFiReactor.setDeadline(clientFd, (elapsed < wait ? wait - elapsed : 0) + 1);
+  }
 }
 
 String WebServer::_extractParam(String& authReq,const String& param,const char delimit){
@@ -337,12 +380,20 @@ void WebServer::handleClient() {
     _currentUpload.reset();
   }
 
+  if (_useReactor) {
+    _updateReactor();
+  }
+
   if (callYield) {
     yield();
   }
 }
 
 void WebServer::close() {
+  bool useReactor = _useReactor;
+  _useReactor = false;
+  _updateReactor();
+  _useReactor = useReactor;
   _server.close();
   _currentStatus = HC_NONE;
   if(!_headerKeysCount)
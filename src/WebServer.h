@@ -76,6 +76,8 @@ public:
   virtual void begin();
   virtual void begin(uint16_t port);
   virtual void handleClient();
+  // run handleClient() from WiFiReactor.poll() when there is something to do
+  void useReactor(bool enable = true);
 
   virtual void close();
   void stop();
@@ -167,6 +169,7 @@ protected:
   int _uploadReadByte(WiFiClient& client);
   void _prepareHeader(String& response, int code, const char* content_type, size_t contentLength);
   bool _collectHeader(const char* headerName, const char* headerValue);
+  void _updateReactor();
 
   void _streamFileCore(const size_t fileSize, const String & fileName, const String & contentType);
 
@@ -210,6 +213,9 @@ protected:
   String           _hostHeader;
   bool             _chunked;
 
+  bool             _useReactor = false;
+  int              _reactorClientFd = -1;
+
   String           _snonce;  // Store noance and opaque for future comparison
   String           _sopaque;
   String           _srealm;  // Store the Auth realm between Calls
@@ -26,6 +26,9 @@
 #define WIFI_CLIENT_SELECT_TIMEOUT_US (1000000)
 #define WIFI_CLIENT_FLUSH_BUFFER_SIZE (1024)
 #define WIFI_CLIENT_KEEPALIVE_TIMEOUT (500)
+#define WIFI_CLIENT_DEF_RX_BUFFER_SIZE (1024)
+#define WIFI_CLIENT_DEF_TX_FLUSH_DELAY (5)
+#define WIFI_CLIENT_TRANSFER_BUFFER_SIZE (2 * 1460)
 
 #undef connect
 #undef write
@@ -35,10 +38,12 @@ class WiFiClientRxBuffer {
 private:
         size_t _size;
         uint8_t *_buffer;
-        size_t _pos;
-        size_t _fill;
+        size_t _head;   // index of the first unread byte
+        size_t _count;  // number of unread bytes
         int _fd;
         bool _failed;
+        bool _eof;          // peer closed its side (FIN)
+        uint32_t _lastRecv; // millis() of the last recv that returned data
 
         size_t r_available()
         {
@@ -53,6 +58,8 @@ private:
             return res;
         }
 
+        // the unread data wraps around the end of _buffer, so the free
+        // space is the largest contiguous span behind it
         size_t fillBuffer()
         {
             if(!_buffer){
@@ -63,32 +70,76 @@ private:
                     return 0;
                 }
             }
-            if(_fill && _pos == _fill){
-                _fill = 0;
-                _pos = 0;
+            if(!_count){
+                _head = 0;
             }
-            if(!_buffer || _size <= _fill) {
+            if(_count >= _size || _eof) {
                 return 0;
             }
-            int res = recv(_fd, _buffer + _fill, _size - _fill, MSG_DONTWAIT);
-            if(res < 0) {
-                if(errno != EWOULDBLOCK) {
-                    _failed = true;
-                }
+            size_t tail = (_head + _count) % _size;
+            size_t space = (tail >= _head) ? (_size - tail) : (_head - tail);
+            int res = recv(_fd, _buffer + tail, space, MSG_DONTWAIT);
+            if(!received(res)) {
                 return 0;
             }
-            _fill += res;
+            _count += res;
             return res;
         }
 
+        // track the link state from what recv returned
+        bool received(int res)
+        {
+            if(res > 0) {
+                _lastRecv = millis();
+                return true;
+            }
+            if(res == 0) {
+                _eof = true;
+            } else if(errno != EWOULDBLOCK) {
+                _failed = true;
+            }
+            return false;
+        }
+
+        size_t contiguous()
+        {
+            size_t span = _size - _head;
+            return (_count < span) ? _count : span;
+        }
+
+        void consume(size_t len)
+        {
+            _head = (_head + len) % _size;
+            _count -= len;
+        }
+
+        size_t copyOut(uint8_t * dst, size_t len)
+        {
+            size_t copied = 0;
+            while(copied < len && _count){
+                size_t span = contiguous();
+                size_t toRead = (span > len - copied)?(len - copied):span;
+                if(toRead == 1){
+                    dst[copied] = _buffer[_head];
+                } else {
+                    memcpy(dst + copied, _buffer + _head, toRead);
+                }
+                consume(toRead);
+                copied += toRead;
+            }
+            return copied;
+        }
+
 public:
-    WiFiClientRxBuffer(int fd, size_t size=1024)
+    WiFiClientRxBuffer(int fd, size_t size=WIFI_CLIENT_DEF_RX_BUFFER_SIZE)
         :_size(size)
         ,_buffer(NULL)
-        ,_pos(0)
-        ,_fill(0)
+        ,_head(0)
+        ,_count(0)
         ,_fd(fd)
         ,_failed(false)
+        ,_eof(false)
+        ,_lastRecv(millis())
     {
         //_buffer = (uint8_t *)malloc(_size);
     }
@@ -102,91 +153,468 @@ public:
         return _failed;
     }
 
+    bool eof(){
+        return _eof;
+    }
+
+    uint32_t lastRecv(){
+        return _lastRecv;
+    }
+
+    /**
+     * change the capacity, unread data is kept
+     * @return false if the unread data does not fit or out of memory
+     */
+    bool resize(size_t size){
+        if(!size || size < _count){
+            return false;
+        }
+        if(_buffer){
+            uint8_t * buffer = (uint8_t *)malloc(size);
+            if(!buffer){
+                log_e("Not enough memory to allocate buffer");
+                return false;
+            }
+            size_t copied = 0;
+            while(_count){
+                size_t span = contiguous();
+                memcpy(buffer + copied, _buffer + _head, span);
+                copied += span;
+                consume(span);
+            }
+            free(_buffer);
+            _buffer = buffer;
+            _head = 0;
+            _count = copied;
+        }
+        _size = size;
+        return true;
+    }
+
     int read(uint8_t * dst, size_t len){
-        if(!dst || !len || (_pos == _fill && !fillBuffer())){
+        if(!dst || !len){
             return -1;
         }
-        size_t a = _fill - _pos;
-        if(len <= a || ((len - a) <= (_size - _fill) && fillBuffer() >= (len - a))){
-            if(len == 1){
-                *dst = _buffer[_pos];
-            } else {
-                memcpy(dst, _buffer + _pos, len);
+        size_t left = len;
+        bool more = true;
+        // hand out what is buffered, then let large reads recv straight
+        // into dst instead of going through _buffer
+        left -= copyOut(dst, left);
+        dst += len - left;
+        while(left >= _size && more && !_eof){
+            int res = recv(_fd, dst, left, MSG_DONTWAIT);
+            if(!received(res)) {
+                more = false;
+                break;
             }
-            _pos += len;
-            return len;
+            left -= res;
+            dst += res;
         }
-        size_t left = len;
-        size_t toRead = a;
-        uint8_t * buf = dst;
-        memcpy(buf, _buffer + _pos, toRead);
-        _pos += toRead;
-        left -= toRead;
-        buf += toRead;
-        while(left){
-            if(!fillBuffer()){
-                return len - left;
+        while(left && more){
+            // refill the space freed so far before running dry
+            if(!fillBuffer() && !_count){
+                break;
             }
-            a = _fill - _pos;
-            toRead = (a > left)?left:a;
-            memcpy(buf, _buffer + _pos, toRead);
-            _pos += toRead;
-            left -= toRead;
-            buf += toRead;
+            size_t copied = copyOut(dst, left);
+            left -= copied;
+            dst += copied;
         }
-        return len;
+        if(left == len){
+            return -1;
+        }
+        return len - left;
     }
 
     int peek(){
-        if(_pos == _fill && !fillBuffer()){
+        if(!_count && !fillBuffer()){
             return -1;
         }
-        return _buffer[_pos];
+        return _buffer[_head];
     }
 
     size_t available(){
-        if (_fill - _pos > 0)
-            return _fill - _pos;
+        if (_count > 0)
+            return _count;
         else
             return r_available();
     }
+
+    size_t peekAvailable(){
+        return _buffer ? contiguous() : 0;
+    }
+
+    const uint8_t * peekBuffer(){
+        return _buffer ? _buffer + _head : NULL;
+    }
+
+    void peekConsume(size_t len){
+        size_t span = peekAvailable();
+        consume((len > span)?span:len);
+    }
     
     void clear(){
         if (r_available()) {
             fillBuffer();
         }
-        _pos = _fill;
+        _head = 0;
+        _count = 0;
+    }
+};
+
+class WiFiClientTxBuffer {
+private:
+    uint8_t *_buffer;
+    size_t _size;
+    size_t _fill;
+    uint32_t _since;    // millis() of the oldest buffered byte
+
+public:
+    WiFiClientTxBuffer(size_t size)
+        :_buffer((uint8_t *)malloc(size))
+        ,_size(size)
+        ,_fill(0)
+        ,_since(0)
+    {
+        if(!_buffer) {
+            log_e("Not enough memory to allocate buffer");
+            _size = 0;
+        }
+    }
+
+    ~WiFiClientTxBuffer()
+    {
+        free(_buffer);
+    }
+
+    size_t size(){
+        return _size;
+    }
+
+    size_t space(){
+        return _size - _fill;
+    }
+
+    size_t pending(){
+        return _fill;
+    }
+
+    const uint8_t * data(){
+        return _buffer;
+    }
+
+    size_t append(const uint8_t * buf, size_t len){
+        if(len > space()){
+            len = space();
+        }
+        if(!_fill){
+            _since = millis();
+        }
+        memcpy(_buffer + _fill, buf, len);
+        _fill += len;
+        return len;
+    }
+
+    bool expired(uint32_t delay){
+        return _fill && (millis() - _since) >= delay;
+    }
+
+    // move the oldest bytes out, the rest moves up
+    size_t take(uint8_t * buf, size_t len){
+        if(len > _fill){
+            len = _fill;
+        }
+        memcpy(buf, _buffer, len);
+        memmove(_buffer, _buffer + len, _fill - len);
+        _fill -= len;
+        return len;
+    }
+
+    void clear(){
+        _fill = 0;
     }
 };
 
 class WiFiClientSocketHandle {
 private:
     int sockfd;
+    WiFiSocketProfile options;  // what is known to be set on the socket
+    std::shared_ptr<WiFiClientTxBuffer> txBuffer;  // one per connection, shared by all copies
+    uint8_t *transferBuf;   // reused by every stream transfer on the connection
 
 public:
-    WiFiClientSocketHandle(int fd):sockfd(fd)
+    WiFiClientSocketHandle(int fd):sockfd(fd),options(WiFiSocketProfile::defaults()),transferBuf(NULL)
     {
     }
 
     ~WiFiClientSocketHandle()
     {
-        lwip_close(sockfd);
+        if(sockfd >= 0) {
+            lwip_close(sockfd);
+        }
+        free(transferBuf);
     }
 
     int fd()
     {
         return sockfd;
     }
+
+    // hand the socket over to another owner
+    void release()
+    {
+        sockfd = -1;
+    }
+
+    WiFiSocketProfile & state()
+    {
+        return options;
+    }
+
+    std::shared_ptr<WiFiClientTxBuffer> & tx()
+    {
+        return txBuffer;
+    }
+
+    // WIFI_CLIENT_TRANSFER_BUFFER_SIZE bytes, allocated on the first transfer
+    uint8_t * transferBuffer()
+    {
+        if(!transferBuf) {
+            transferBuf = (uint8_t *)malloc(WIFI_CLIENT_TRANSFER_BUFFER_SIZE);
+        }
+        return transferBuf;
+    }
+};
+
+/**
+ * a connectAsync(host) waiting for its name, shared with the DNS callback
+ * that starts the connect. A socket nobody took is closed with it.
+ */
+class WiFiClientConnectLookup {
+public:
+    uint16_t port;
+    int sockfd;
+    int error;
+    bool done;      // set last by the callback
+
+    WiFiClientConnectLookup(uint16_t p):port(p),sockfd(-1),error(0),done(false)
+    {
+    }
+
+    ~WiFiClientConnectLookup()
+    {
+        if(sockfd >= 0) {
+            lwip_close(sockfd);
+        }
+    }
 };
 
-WiFiClient::WiFiClient():_connected(false),next(NULL)
+WiFiSocketProfile::WiFiSocketProfile()
+    :_set(0)
+    ,_noDelay(0)
+    ,_keepAlive(0)
+    ,_keepIdle(0)
+    ,_keepInterval(0)
+    ,_keepCount(0)
+    ,_rcvTimeout(0)
+    ,_sndTimeout(0)
+    ,_rcvBuf(0)
+    ,_sndBuf(0)
+{
+}
+
+WiFiSocketProfile WiFiSocketProfile::defaults()
+{
+    WiFiSocketProfile profile;
+    profile.setNoDelay(false).setKeepAlive(false).setTimeout(0);
+    return profile;
+}
+
+WiFiSocketProfile & WiFiSocketProfile::setNoDelay(bool nodelay)
+{
+    _noDelay = nodelay;
+    _set |= OPT_NODELAY;
+    return *this;
+}
+
+WiFiSocketProfile & WiFiSocketProfile::setKeepAlive(bool enable)
+{
+    _keepAlive = enable;
+    _set |= OPT_KEEPALIVE;
+    return *this;
+}
+
+/**
+ * @param idle int      seconds without traffic before the first probe
+ * @param interval int  seconds between probes
+ * @param count int     unanswered probes before the connection is dropped
+ */
+WiFiSocketProfile & WiFiSocketProfile::setKeepAliveParams(int idle, int interval, int count)
+{
+    _keepIdle = idle;
+    _keepInterval = interval;
+    _keepCount = count;
+    _set |= OPT_KEEPIDLE | OPT_KEEPINTVL | OPT_KEEPCNT;
+    return *this;
+}
+
+WiFiSocketProfile & WiFiSocketProfile::setTimeout(uint32_t ms)
+{
+    return setRecvTimeout(ms).setSendTimeout(ms);
+}
+
+WiFiSocketProfile & WiFiSocketProfile::setRecvTimeout(uint32_t ms)
+{
+    _rcvTimeout = ms;
+    _set |= OPT_RCVTIMEO;
+    return *this;
+}
+
+WiFiSocketProfile & WiFiSocketProfile::setSendTimeout(uint32_t ms)
+{
+    _sndTimeout = ms;
+    _set |= OPT_SNDTIMEO;
+    return *this;
+}
+
+/**
+ * @param bytes int     SO_RCVBUF, lwip only has it with LWIP_SO_RCVBUF
+ */
+WiFiSocketProfile & WiFiSocketProfile::setRecvBufferSize(int bytes)
+{
+    _rcvBuf = bytes;
+    _set |= OPT_RCVBUF;
+    return *this;
+}
+
+/**
+ * @param bytes int     SO_SNDBUF, which lwip does not have, apply() skips it there
+ */
+WiFiSocketProfile & WiFiSocketProfile::setSendBufferSize(int bytes)
+{
+    _sndBuf = bytes;
+    _set |= OPT_SNDBUF;
+    return *this;
+}
+
+/**
+ * take over the options set in other
+ */
+void WiFiSocketProfile::merge(const WiFiSocketProfile &other)
+{
+    uint16_t set = other._set;
+    if(set & OPT_NODELAY)   _noDelay = other._noDelay;
+    if(set & OPT_KEEPALIVE) _keepAlive = other._keepAlive;
+    if(set & OPT_KEEPIDLE)  _keepIdle = other._keepIdle;
+    if(set & OPT_KEEPINTVL) _keepInterval = other._keepInterval;
+    if(set & OPT_KEEPCNT)   _keepCount = other._keepCount;
+    if(set & OPT_RCVTIMEO)  _rcvTimeout = other._rcvTimeout;
+    if(set & OPT_SNDTIMEO)  _sndTimeout = other._sndTimeout;
+    if(set & OPT_RCVBUF)    _rcvBuf = other._rcvBuf;
+    if(set & OPT_SNDBUF)    _sndBuf = other._sndBuf;
+    _set |= set;
+}
+
+bool WiFiSocketProfile::getNoDelay(bool &nodelay) const
+{
+    nodelay = _noDelay;
+    return _set & OPT_NODELAY;
+}
+
+/**
+ * an option the stack does not have is skipped instead of failing the profile
+ */
+static bool optionUnsupported(int name)
+{
+    if(errno != ENOPROTOOPT && errno != EINVAL) {
+        return false;
+    }
+    log_w("option %X not supported, skipped: %d", name, errno);
+    return true;
+}
+
+/**
+ * set the options of this profile on a socket in one pass,
+ * skipping those state says the socket already has
+ * @param fd int
+ * @param state WiFiSocketProfile &   known options of the socket, updated
+ * @return 0 on success, -1 if an option could not be set
+ */
+int WiFiSocketProfile::apply(int fd, WiFiSocketProfile &state) const
+{
+    uint16_t skipped = 0;
+    struct {
+        uint16_t opt;
+        int level;
+        int name;
+        int value;
+        int current;
+    } ints[] = {
+        { OPT_NODELAY,   IPPROTO_TCP, TCP_NODELAY,   _noDelay,      state._noDelay },
+        { OPT_KEEPALIVE, SOL_SOCKET,  SO_KEEPALIVE,  _keepAlive,    state._keepAlive },
+        { OPT_KEEPIDLE,  IPPROTO_TCP, TCP_KEEPIDLE,  _keepIdle,     state._keepIdle },
+        { OPT_KEEPINTVL, IPPROTO_TCP, TCP_KEEPINTVL, _keepInterval, state._keepInterval },
+        { OPT_KEEPCNT,   IPPROTO_TCP, TCP_KEEPCNT,   _keepCount,    state._keepCount },
+        { OPT_RCVBUF,    SOL_SOCKET,  SO_RCVBUF,     _rcvBuf,       state._rcvBuf },
+        { OPT_SNDBUF,    SOL_SOCKET,  SO_SNDBUF,     _sndBuf,       state._sndBuf },
+    };
+    for(size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        if(!(_set & ints[i].opt) || ((state._set & ints[i].opt) && ints[i].value == ints[i].current)) {
+            continue;
+        }
+        if(setsockopt(fd, ints[i].level, ints[i].name, (char *)&ints[i].value, sizeof(int)) < 0) {
+            if(optionUnsupported(ints[i].name)) {
+                skipped |= ints[i].opt;
+                continue;
+            }
+            log_e("%X : %d", ints[i].name, errno);
+            // options before this one were set, nothing is known for sure
+            state = WiFiSocketProfile();
+            return -1;
+        }
+    }
+
+    struct {
+        uint16_t opt;
+        int name;
+        uint32_t value;
+        uint32_t current;
+    } timeouts[] = {
+        { OPT_RCVTIMEO, SO_RCVTIMEO, _rcvTimeout, state._rcvTimeout },
+        { OPT_SNDTIMEO, SO_SNDTIMEO, _sndTimeout, state._sndTimeout },
+    };
+    for(size_t i = 0; i < sizeof(timeouts) / sizeof(timeouts[0]); i++) {
+        if(!(_set & timeouts[i].opt) || ((state._set & timeouts[i].opt) && timeouts[i].value == timeouts[i].current)) {
+            continue;
+        }
+        struct timeval tv;
+        tv.tv_sec = timeouts[i].value / 1000;
+        tv.tv_usec = (timeouts[i].value % 1000) * 1000;
+        if(setsockopt(fd, SOL_SOCKET, timeouts[i].name, (char *)&tv, sizeof(struct timeval)) < 0) {
+            if(optionUnsupported(timeouts[i].name)) {
+                skipped |= timeouts[i].opt;
+                continue;
+            }
+            log_e("%X : %d", timeouts[i].name, errno);
+            state = WiFiSocketProfile();
+            return -1;
+        }
+    }
+
+    WiFiSocketProfile applied = *this;
+    applied._set &= ~skipped;
+    state.merge(applied);
+    return 0;
+}
+
+WiFiClient::WiFiClient():_connected(false),_rxBufferSize(WIFI_CLIENT_DEF_RX_BUFFER_SIZE),_txBufferSize(0),_txFlushDelay(WIFI_CLIENT_DEF_TX_FLUSH_DELAY),next(NULL)
 {
 }
 
-WiFiClient::WiFiClient(int fd):_connected(true),next(NULL)
+WiFiClient::WiFiClient(int fd):_connected(true),_rxBufferSize(WIFI_CLIENT_DEF_RX_BUFFER_SIZE),_txBufferSize(0),_txFlushDelay(WIFI_CLIENT_DEF_TX_FLUSH_DELAY),next(NULL)
 {
     clientSocketHandle.reset(new WiFiClientSocketHandle(fd));
-    _rxBuffer.reset(new WiFiClientRxBuffer(fd));
+    _rxBuffer.reset(new WiFiClientRxBuffer(fd, _rxBufferSize));
+    conn_staus = millis();
 }
 
 WiFiClient::~WiFiClient()
@@ -199,16 +627,28 @@ WiFiClient & WiFiClient::operator=(const WiFiClient &other)
     stop();
     clientSocketHandle = other.clientSocketHandle;
     _rxBuffer = other._rxBuffer;
+    _rxBufferSize = other._rxBufferSize;
+    _txBufferSize = other._txBufferSize;
+    _txFlushDelay = other._txFlushDelay;
+    _socketProfile = other._socketProfile;
     _connected = other._connected;
     return *this;
 }
 
 void WiFiClient::stop()
 {
+    // send what is still buffered, even if other copies share the buffer
+    flushTxBuffer();
     clientSocketHandle = NULL;
     _rxBuffer.reset();
     _rxBuffer = NULL;
     _connected = false;
+    if(_pendingSocket || _connectLookup) {
+        // abort a connectAsync() in progress
+        _pendingSocket = NULL;
+        _connectLookup = NULL;
+        _connectState = WIFI_CLIENT_CONNECT_IDLE;
+    }
 }
 
 int WiFiClient::connect(IPAddress ip, uint16_t port)
@@ -217,19 +657,11 @@ int WiFiClient::connect(IPAddress ip, uint16_t port)
 }
 int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
 {
-    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    int sockfd = connectStart(ip, port);
     if (sockfd < 0) {
-        log_e("socket: %d", errno);
         return 0;
     }
-    fcntl( sockfd, F_SETFL, fcntl( sockfd, F_GETFL, 0 ) | O_NONBLOCK );
 
-    uint32_t ip_addr = ip;
-    struct sockaddr_in serveraddr;
-    bzero((char *) &serveraddr, sizeof(serveraddr));
-    serveraddr.sin_family = AF_INET;
-    bcopy((const void *)(&ip_addr), (void *)&serveraddr.sin_addr.s_addr, 4);
-    serveraddr.sin_port = htons(port);
     fd_set fdset;
     struct timeval tv;
     FD_ZERO(&fdset);
@@ -237,14 +669,7 @@ int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
     tv.tv_sec = 0;
     tv.tv_usec = timeout * 1000;
 
-    int res = lwip_connect_r(sockfd, (struct sockaddr*)&serveraddr, sizeof(serveraddr));
-    if (res < 0 && errno != EINPROGRESS) {
-        log_e("connect on fd %d, errno: %d, \"%s\"", sockfd, errno, strerror(errno));
-        lwip_close(sockfd);
-        return 0;
-    }
-
-    res = lwip_select(sockfd + 1, nullptr, &fdset, nullptr, timeout<0 ? nullptr : &tv);
+    int res = lwip_select(sockfd + 1, nullptr, &fdset, nullptr, timeout<0 ? nullptr : &tv);
     if (res < 0) {
         log_e("select on fd %d, errno: %d, \"%s\"", sockfd, errno, strerror(errno));
         lwip_close(sockfd);
@@ -253,32 +678,217 @@ int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
         log_i("select returned due to timeout %d ms for fd %d", timeout, sockfd);
         lwip_close(sockfd);
         return 0;
-    } else {
-        int sockerr;
-        socklen_t len = (socklen_t)sizeof(int);
-        res = getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &sockerr, &len);
+    }
 
-        if (res < 0) {
-            log_e("getsockopt on fd %d, errno: %d, \"%s\"", sockfd, errno, strerror(errno));
-            lwip_close(sockfd);
-            return 0;
-        }
+    if (connectFinish(sockfd) != 0) {
+        lwip_close(sockfd);
+        return 0;
+    }
+    attach(sockfd);
+    return 1;
+}
 
-        if (sockerr != 0) {
-            log_e("socket error on fd %d, errno: %d, \"%s\"", sockfd, sockerr, strerror(sockerr));
-            lwip_close(sockfd);
-            return 0;
-        }
+/**
+ * create a non-blocking socket and start connecting it
+ * @return the socket or -1
+ */
+int WiFiClient::connectStart(IPAddress ip, uint16_t port)
+{
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        log_e("socket: %d", errno);
+        return -1;
+    }
+    fcntl( sockfd, F_SETFL, fcntl( sockfd, F_GETFL, 0 ) | O_NONBLOCK );
+
+    uint32_t ip_addr = ip;
+    struct sockaddr_in serveraddr;
+    bzero((char *) &serveraddr, sizeof(serveraddr));
+    serveraddr.sin_family = AF_INET;
+    bcopy((const void *)(&ip_addr), (void *)&serveraddr.sin_addr.s_addr, 4);
+    serveraddr.sin_port = htons(port);
+
+    int res = lwip_connect_r(sockfd, (struct sockaddr*)&serveraddr, sizeof(serveraddr));
+    if (res < 0 && errno != EINPROGRESS) {
+        log_e("connect on fd %d, errno: %d, \"%s\"", sockfd, errno, strerror(errno));
+        lwip_close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+/**
+ * check the outcome of a connect once the socket became writable
+ * @return 0 if connected, the socket error otherwise
+ */
+int WiFiClient::connectFinish(int sockfd)
+{
+    int sockerr;
+    socklen_t len = (socklen_t)sizeof(int);
+    int res = getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &sockerr, &len);
+
+    if (res < 0) {
+        log_e("getsockopt on fd %d, errno: %d, \"%s\"", sockfd, errno, strerror(errno));
+        return errno ? errno : EIO;
     }
 
+    if (sockerr != 0) {
+        log_e("socket error on fd %d, errno: %d, \"%s\"", sockfd, sockerr, strerror(sockerr));
+        return sockerr;
+    }
+    return 0;
+}
+
+/**
+ * take over a connected socket
+ */
+void WiFiClient::attach(int sockfd)
+{
     fcntl( sockfd, F_SETFL, fcntl( sockfd, F_GETFL, 0 ) & (~O_NONBLOCK) );
     clientSocketHandle.reset(new WiFiClientSocketHandle(sockfd));
-    _rxBuffer.reset(new WiFiClientRxBuffer(sockfd));
+    _rxBuffer.reset(new WiFiClientRxBuffer(sockfd, _rxBufferSize));
+    if(_socketProfile.apply(sockfd, clientSocketHandle->state()) < 0) {
+        log_e("socket options on fd %d could not be applied", sockfd);
+    }
     conn_staus = millis();
     _connected = true;
+}
+
+/**
+ * start connecting without waiting for the result,
+ * call connectPoll() until it is no longer WIFI_CLIENT_CONNECT_PENDING
+ * @param timeout int32_t   ms, -1 waits as long as the stack does
+ * @return 1 if the attempt was started
+ */
+int WiFiClient::connectAsync(IPAddress ip, uint16_t port, int32_t timeout)
+{
+    stop();
+    _connectError = 0;
+    int sockfd = connectStart(ip, port);
+    if (sockfd < 0) {
+        _connectError = errno ? errno : EIO;
+        _connectState = WIFI_CLIENT_CONNECT_FAILED;
+        return 0;
+    }
+    _pendingSocket.reset(new WiFiClientSocketHandle(sockfd));
+    _connectStart = millis();
+    _connectTimeout = timeout;
+    _connectState = WIFI_CLIENT_CONNECT_PENDING;
+    return 1;
+}
+
+/**
+ * resolves the host without waiting, the connect starts from the DNS
+ * callback and connectPoll() picks it up. The timeout covers both.
+ */
+int WiFiClient::connectAsync(const char *host, uint16_t port, int32_t timeout)
+{
+    stop();
+    _connectError = 0;
+    std::shared_ptr<WiFiClientConnectLookup> lookup(new WiFiClientConnectLookup(port));
+    _connectLookup = lookup;
+    _connectStart = millis();
+    _connectTimeout = timeout;
+    _connectState = WIFI_CLIENT_CONNECT_PENDING;
+    int started = WiFiGenericClass::hostByName(host, [lookup](const char *name, IPAddress ip) {
+        if (!(uint32_t)ip) {
+            lookup->error = EHOSTUNREACH;
+        } else {
+            lookup->sockfd = connectStart(ip, lookup->port);
+            if (lookup->sockfd < 0) {
+                lookup->error = errno ? errno : EIO;
+            }
+        }
+        __atomic_store_n(&lookup->done, true, __ATOMIC_RELEASE);
+    });
+    if (!started) {
+        _connectLookup = NULL;
+        _connectError = EHOSTUNREACH;
+        _connectState = WIFI_CLIENT_CONNECT_FAILED;
+        return 0;
+    }
     return 1;
 }
 
+/**
+ * check a connect started by connectAsync() without blocking,
+ * the onConnect callback runs once when it completes
+ * @return wifi_client_connect_t
+ */
+wifi_client_connect_t WiFiClient::connectPoll()
+{
+    if (_connectState != WIFI_CLIENT_CONNECT_PENDING) {
+        return _connectState;
+    }
+    bool expired = _connectTimeout >= 0 && (int32_t)(millis() - _connectStart) >= _connectTimeout;
+    if (_connectLookup) {
+        // connectAsync(host) still waits for its name
+        if (__atomic_load_n(&_connectLookup->done, __ATOMIC_ACQUIRE)) {
+            _connectError = _connectLookup->error;
+            if (!_connectError) {
+                _pendingSocket.reset(new WiFiClientSocketHandle(_connectLookup->sockfd));
+                _connectLookup->sockfd = -1;
+            }
+        } else if (expired) {
+            log_i("connect timeout %d ms while resolving", _connectTimeout);
+            _connectError = ETIMEDOUT;
+        } else {
+            return _connectState;
+        }
+        _connectLookup = NULL;
+    }
+
+    int sockfd = _pendingSocket ? _pendingSocket->fd() : -1;
+    if (!_connectError) {
+        fd_set fdset;
+        struct timeval tv = {0, 0};
+        FD_ZERO(&fdset);
+        FD_SET(sockfd, &fdset);
+
+        int res = lwip_select(sockfd + 1, nullptr, &fdset, nullptr, &tv);
+        if (res < 0) {
+            log_e("select on fd %d, errno: %d, \"%s\"", sockfd, errno, strerror(errno));
+            _connectError = errno ? errno : EIO;
+        } else if (res == 0) {
+            if (!expired) {
+                return _connectState;
+            }
+            log_i("connect timeout %d ms for fd %d", _connectTimeout, sockfd);
+            _connectError = ETIMEDOUT;
+        } else {
+            _connectError = connectFinish(sockfd);
+        }
+    }
+
+    if (_connectError) {
+        _pendingSocket = NULL;
+        _connectState = WIFI_CLIENT_CONNECT_FAILED;
+    } else {
+        // the socket now belongs to the connection
+        attach(sockfd);
+        _pendingSocket->release();
+        _pendingSocket = NULL;
+        _connectState = WIFI_CLIENT_CONNECT_SUCCESS;
+    }
+    if (_connectCallback) {
+        _connectCallback(*this, _connectError);
+    }
+    return _connectState;
+}
+
+/**
+ * errno of the last failed connectAsync(), ETIMEDOUT on timeout
+ */
+int WiFiClient::connectError()
+{
+    return _connectError;
+}
+
+void WiFiClient::onConnect(ConnectCallback callback)
+{
+    _connectCallback = callback;
+}
+
 int WiFiClient::connect(const char *host, uint16_t port)
 {
     return connect(host,port,-1);
@@ -298,19 +908,47 @@ int WiFiClient::setSocketOption(int option, char* value, size_t len)
     if(res < 0) {
         log_e("%X : %d", option, errno);
     }
+    forgetSocketState();
     return res;
 }
 
 int WiFiClient::setTimeout(uint32_t seconds)
 {
     Client::setTimeout(seconds * 1000);
-    struct timeval tv;
-    tv.tv_sec = seconds;
-    tv.tv_usec = 0;
-    if(setSocketOption(SO_RCVTIMEO, (char *)&tv, sizeof(struct timeval)) < 0) {
-        return -1;
+    WiFiSocketProfile profile;
+    profile.setTimeout(seconds * 1000);
+    return setSocketProfile(profile);
+}
+
+/**
+ * set socket options, they are applied now if connected and again on
+ * every connect. options already in place are not set again
+ * @param profile const WiFiSocketProfile &   options to change
+ * @return 0 on success
+ */
+int WiFiClient::setSocketProfile(const WiFiSocketProfile &profile)
+{
+    _socketProfile.merge(profile);
+    if(!clientSocketHandle) {
+        return 0;
+    }
+    return profile.apply(clientSocketHandle->fd(), clientSocketHandle->state());
+}
+
+const WiFiSocketProfile & WiFiClient::getSocketProfile()
+{
+    return _socketProfile;
+}
+
+/**
+ * options set around the profile make the known state unreliable,
+ * the next profile sets all of its options again
+ */
+void WiFiClient::forgetSocketState()
+{
+    if(clientSocketHandle) {
+        clientSocketHandle->state() = WiFiSocketProfile();
     }
-    return setSocketOption(SO_SNDTIMEO, (char *)&tv, sizeof(struct timeval));
 }
 
 int WiFiClient::setOption(int option, int *value)
@@ -319,6 +957,7 @@ int WiFiClient::setOption(int option, int *value)
     if(res < 0) {
         log_e("fail on fd %d, errno: %d, \"%s\"", fd(), errno, strerror(errno));
     }
+    forgetSocketState();
     return res;
 }
 
@@ -334,12 +973,17 @@ int WiFiClient::getOption(int option, int *value)
 
 int WiFiClient::setNoDelay(bool nodelay)
 {
-    int flag = nodelay;
-    return setOption(TCP_NODELAY, &flag);
+    WiFiSocketProfile profile;
+    profile.setNoDelay(nodelay);
+    return setSocketProfile(profile);
 }
 
 bool WiFiClient::getNoDelay()
 {
+    bool nodelay;
+    if(clientSocketHandle && clientSocketHandle->state().getNoDelay(nodelay)) {
+        return nodelay;
+    }
     int flag = 0;
     getOption(TCP_NODELAY, &flag);
     return flag;
@@ -360,7 +1004,41 @@ int WiFiClient::read()
     return data;
 }
 
+/**
+ * write through the transmit buffer if one is set, small writes are
+ * collected and sent together
+ */
 size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+    if(!_txBufferSize || !_connected || !size || !clientSocketHandle) {
+        return writeDirect(buf, size);
+    }
+    // kept on the socket handle, so every copy of the client writes in order
+    std::shared_ptr<WiFiClientTxBuffer> tx = clientSocketHandle->tx();
+    if(!tx) {
+        tx.reset(new WiFiClientTxBuffer(_txBufferSize));
+        clientSocketHandle->tx() = tx;
+    }
+    if(!tx->size()) {
+        return writeDirect(buf, size);
+    }
+    if(tx->expired(_txFlushDelay) || size > tx->space()) {
+        if(!flushTxBuffer()) {
+            return 0;
+        }
+    }
+    if(size >= tx->size()) {
+        // nothing to gain from copying
+        return writeDirect(buf, size);
+    }
+    tx->append(buf, size);
+    if(!tx->space() && !flushTxBuffer()) {
+        return 0;
+    }
+    return size;
+}
+
+size_t WiFiClient::writeDirect(const uint8_t *buf, size_t size)
 {
     int res =0;
     int retry = WIFI_CLIENT_MAX_WRITE_RETRY;
@@ -373,7 +1051,30 @@ size_t WiFiClient::write(const uint8_t *buf, size_t size)
     }
 
     while(retry) {
-        //use select to make sure the socket is ready for writing
+        // try to send right away, the socket is writable most of the time
+        // and every select is another round trip
+        _ioStats.sends++;
+        res = send(socketFileDescriptor, (void*) buf, bytesRemaining, MSG_DONTWAIT);
+        if(res > 0) {
+            conn_staus = millis();
+            totalBytesSent += res;
+            if (totalBytesSent >= size) {
+                //completed successfully
+                break;
+            }
+            buf += res;
+            bytesRemaining -= res;
+            retry = WIFI_CLIENT_MAX_WRITE_RETRY;
+            continue;
+        }
+        if(res < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            //if resource was busy, can try again, otherwise give up
+            log_e("fail on fd %d, errno: %d, \"%s\"", fd(), errno, strerror(errno));
+            stop();
+            break;
+        }
+
+        //the send buffer is full, use select to wait until the socket is ready for writing
         fd_set set;
         struct timeval tv;
         FD_ZERO(&set);        // empties the set
@@ -382,36 +1083,10 @@ size_t WiFiClient::write(const uint8_t *buf, size_t size)
         tv.tv_usec = WIFI_CLIENT_SELECT_TIMEOUT_US;
         retry--;
 
+        _ioStats.selects++;
         if(lwip_select(socketFileDescriptor + 1, NULL, &set, NULL, &tv) < 0) {
             return 0;
         }
-
-        if(FD_ISSET(socketFileDescriptor, &set)) {
-            res = send(socketFileDescriptor, (void*) buf, bytesRemaining, MSG_DONTWAIT);
-            if(res > 0) {
-                totalBytesSent += res;
-                if (totalBytesSent >= size) {
-                    //completed successfully
-                    retry = 0;
-                } else {
-                    buf += res;
-                    bytesRemaining -= res;
-                    retry = WIFI_CLIENT_MAX_WRITE_RETRY;
-                }
-            }
-            else if(res < 0) {
-                log_e("fail on fd %d, errno: %d, \"%s\"", fd(), errno, strerror(errno));
-                if(errno != EAGAIN) {
-                    //if resource was busy, can try again, otherwise give up
-                    stop();
-                    res = 0;
-                    retry = 0;
-                }
-            }
-            else {
-                // Try again
-            }
-        }
     }
     return totalBytesSent;
 }
@@ -423,20 +1098,133 @@ size_t WiFiClient::write_P(PGM_P buf, size_t size)
 
 size_t WiFiClient::write(Stream &stream)
 {
-    uint8_t * buf = (uint8_t *)malloc(1360);
-    if(!buf){
+    return transfer(stream, SIZE_MAX, 0);
+}
+
+/**
+ * copy data from a stream to the socket until max bytes are sent or the
+ * stream had nothing new for the client timeout (see setTimeout)
+ * @param stream Stream &   source, e.g. a File or Serial
+ * @param max size_t        max bytes to send
+ * @return bytes sent
+ */
+size_t WiFiClient::transferFrom(Stream &stream, size_t max)
+{
+    return transfer(stream, max, _timeout);
+}
+
+/**
+ * statistics of the last transferFrom() or write(Stream&)
+ */
+const wifiClientTransferStats_t & WiFiClient::getTransferStats()
+{
+    return _transferStats;
+}
+
+size_t WiFiClient::transfer(Stream &stream, size_t max, uint32_t idleTimeout)
+{
+    const size_t size = WIFI_CLIENT_TRANSFER_BUFFER_SIZE;
+    int socketFileDescriptor = fd();
+
+    memset(&_transferStats, 0, sizeof(_transferStats));
+    if(!_connected || (socketFileDescriptor < 0) || !max) {
+        return 0;
+    }
+    // keep the order of earlier buffered writes
+    if(!flushTxBuffer()) {
         return 0;
     }
-    size_t toRead = 0, toWrite = 0, written = 0;
-    size_t available = stream.available();
-    while(available){
-        toRead = (available > 1360)?1360:available;
-        toWrite = stream.readBytes(buf, toRead);
-        written += write(buf, toWrite);
-        available = stream.available();
+
+    // a failing send stops the client, the handle keeps the buffer alive until the end
+    std::shared_ptr<WiFiClientSocketHandle> handle = clientSocketHandle;
+    uint8_t * buf = handle->transferBuffer();
+    if(!buf) {
+        log_e("Not enough memory to allocate buffer");
+        return 0;
+    }
+
+    unsigned long start = millis();
+    unsigned long lastData = start;
+    size_t head = 0, fill = 0, taken = 0, sent = 0;
+    int retry = WIFI_CLIENT_MAX_WRITE_RETRY;
+
+    while(_connected) {
+        // read ahead from the source while there is room
+        if(taken < max) {
+            if(head && (size - fill) < size / 2) {
+                memmove(buf, buf + head, fill - head);
+                fill -= head;
+                head = 0;
+            }
+            int available = stream.available();
+            if(available > 0 && fill < size) {
+                size_t toRead = size - fill;
+                if(toRead > (size_t)available) {
+                    toRead = available;
+                }
+                if(toRead > max - taken) {
+                    toRead = max - taken;
+                }
+                toRead = stream.readBytes(buf + fill, toRead);
+                fill += toRead;
+                taken += toRead;
+                lastData = millis();
+            }
+        }
+
+        if(head == fill) {
+            head = fill = 0;
+            if(taken >= max || (millis() - lastData) >= idleTimeout) {
+                break;
+            }
+            // the source has nothing yet
+            delay(1);
+            continue;
+        }
+
+        _ioStats.sends++;
+        _transferStats.sends++;
+        int res = send(socketFileDescriptor, (void*) (buf + head), fill - head, MSG_DONTWAIT);
+        if(res > 0) {
+            conn_staus = millis();
+            head += res;
+            sent += res;
+            retry = WIFI_CLIENT_MAX_WRITE_RETRY;
+            continue;
+        }
+        if(res < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            log_e("fail on fd %d, errno: %d, \"%s\"", socketFileDescriptor, errno, strerror(errno));
+            stop();
+            break;
+        }
+        // the socket is full, keep reading from the source instead of waiting
+        if(taken < max && fill < size && stream.available() > 0) {
+            continue;
+        }
+        if(!retry--) {
+            break;
+        }
+
+        fd_set set;
+        struct timeval tv;
+        FD_ZERO(&set);
+        FD_SET(socketFileDescriptor, &set);
+        tv.tv_sec = 0;
+        tv.tv_usec = WIFI_CLIENT_SELECT_TIMEOUT_US;
+        _ioStats.selects++;
+        _transferStats.waits++;
+        if(lwip_select(socketFileDescriptor + 1, NULL, &set, NULL, &tv) < 0) {
+            break;
+        }
+    }
+
+    _transferStats.bytes = sent;
+    _transferStats.duration = millis() - start;
+    if(_transferStats.duration) {
+        _transferStats.bytesPerSecond = (uint64_t) sent * 1000 / _transferStats.duration;
     }
-    free(buf);
-    return written;
+    log_d("transfer: %d bytes in %d ms, %d sends, %d waits", sent, _transferStats.duration, _transferStats.sends, _transferStats.waits);
+    return sent;
 }
 
 int WiFiClient::read(uint8_t *buf, size_t size)
@@ -462,6 +1250,7 @@ int WiFiClient::peek()
 
 int WiFiClient::available()
 {
+    flushIfDue();
     if(!_rxBuffer)
     {
         return 0;
@@ -474,7 +1263,197 @@ int WiFiClient::available()
     return res;
 }
 
-void WiFiClient::flush() {}
+/**
+ * wait until data is buffered or the socket becomes readable
+ * @param timeout uint32_t  max time to wait in ms
+ * @return bytes available, 0 on timeout
+ */
+int WiFiClient::waitAvailable(uint32_t timeout)
+{
+    // the peer will not answer what it has not received yet
+    flushTxBuffer();
+    int res = available();
+    int socketFileDescriptor = fd();
+    if(res > 0 || !_connected || socketFileDescriptor < 0) {
+        return res;
+    }
+    fd_set set;
+    struct timeval tv;
+    FD_ZERO(&set);
+    FD_SET(socketFileDescriptor, &set);
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    if(lwip_select(socketFileDescriptor + 1, &set, NULL, NULL, &tv) <= 0) {
+        return 0;
+    }
+    return available();
+}
+
+/**
+ * number of contiguous bytes that can be accessed through peekBuffer()
+ * refills the receive buffer if it is empty
+ */
+size_t WiFiClient::peekAvailable()
+{
+    if(available() <= 0) {
+        return 0;
+    }
+    return _rxBuffer->peekAvailable();
+}
+
+/**
+ * pointer to the unread data in the receive buffer
+ * only valid until the next read, peekConsume or refill
+ */
+const uint8_t * WiFiClient::peekBuffer()
+{
+    if(!_rxBuffer) {
+        return NULL;
+    }
+    return _rxBuffer->peekBuffer();
+}
+
+/**
+ * drop bytes from the receive buffer after they were handled via peekBuffer()
+ */
+void WiFiClient::peekConsume(size_t consume)
+{
+    if(_rxBuffer) {
+        _rxBuffer->peekConsume(consume);
+    }
+}
+
+/**
+ * set the capacity of the receive buffer, used by the next connect
+ * and applied to the current connection right away
+ * @param size size_t   bytes
+ * @return false if the buffered data does not fit or out of memory
+ */
+bool WiFiClient::setRxBufferSize(size_t size)
+{
+    if(!size) {
+        return false;
+    }
+    if(_rxBuffer && !_rxBuffer->resize(size)) {
+        return false;
+    }
+    _rxBufferSize = size;
+    return true;
+}
+
+size_t WiFiClient::getRxBufferSize()
+{
+    return _rxBufferSize;
+}
+
+/**
+ * enable the transmit buffer, writes are collected until it is full,
+ * flush() is called or data waited longer than the flush delay
+ * @param size size_t   bytes, 0 sends every write right away
+ */
+void WiFiClient::setTxBufferSize(size_t size)
+{
+    if(size == _txBufferSize) {
+        return;
+    }
+    flushTxBuffer();
+    if(clientSocketHandle) {
+        clientSocketHandle->tx() = NULL;
+    }
+    _txBufferSize = size;
+}
+
+size_t WiFiClient::getTxBufferSize()
+{
+    return _txBufferSize;
+}
+
+/**
+ * number of send and select calls made by this client
+ */
+const wifiClientIoStats_t & WiFiClient::getIoStats()
+{
+    return _ioStats;
+}
+
+void WiFiClient::resetIoStats()
+{
+    memset(&_ioStats, 0, sizeof(_ioStats));
+}
+
+/**
+ * max time buffered data waits for more, checked on the next
+ * write, available() or connected()
+ * @param ms uint32_t
+ */
+void WiFiClient::setTxFlushDelay(uint32_t ms)
+{
+    _txFlushDelay = ms;
+}
+
+/**
+ * send the buffered data
+ * @return false if it could not be sent completely
+ */
+bool WiFiClient::flushTxBuffer()
+{
+    // keep the buffer alive, a failing write stops the client
+    std::shared_ptr<WiFiClientTxBuffer> tx;
+    if(clientSocketHandle) {
+        tx = clientSocketHandle->tx();
+    }
+    if(!tx || !tx->pending()) {
+        return true;
+    }
+    size_t len = tx->pending();
+    tx->clear();
+    return writeDirect(tx->data(), len) == len;
+}
+
+/**
+ * @return bytes waiting in the transmit buffer
+ */
+size_t WiFiClient::txPending()
+{
+    if(!clientSocketHandle || !clientSocketHandle->tx()) {
+        return 0;
+    }
+    return clientSocketHandle->tx()->pending();
+}
+
+/**
+ * move the oldest bytes out of the transmit buffer without sending them
+ * @return bytes moved
+ */
+size_t WiFiClient::takeTxBuffer(uint8_t *buf, size_t size)
+{
+    if(!clientSocketHandle || !clientSocketHandle->tx()) {
+        return 0;
+    }
+    return clientSocketHandle->tx()->take(buf, size);
+}
+
+/**
+ * drop the buffered data of a connection that is being torn down
+ */
+void WiFiClient::discardTxBuffer()
+{
+    if(clientSocketHandle && clientSocketHandle->tx()) {
+        clientSocketHandle->tx()->clear();
+    }
+}
+
+void WiFiClient::flushIfDue()
+{
+    if(clientSocketHandle && clientSocketHandle->tx() && clientSocketHandle->tx()->expired(_txFlushDelay)) {
+        flushTxBuffer();
+    }
+}
+
+void WiFiClient::flush()
+{
+    flushTxBuffer();
+}
 
 void WiFiClient::clear(){
     if(_rxBuffer != nullptr){
@@ -484,8 +1463,28 @@ void WiFiClient::clear(){
 
 uint8_t WiFiClient::connected()
 {
-    uint32_t interval = millis() - conn_staus;
-    if (_connected && interval > WIFI_CLIENT_KEEPALIVE_TIMEOUT) {
+    flushIfDue();
+    // data that arrived before the close can still be read
+    auto buffered = [this]() { return _rxBuffer && _rxBuffer->available() > 0; };
+    if (!_connected) {
+        return buffered();
+    }
+    if (_rxBuffer && _rxBuffer->failed()) {
+        log_d("Disconnected: socket error");
+        _connected = false;
+        return buffered();
+    }
+    if (_rxBuffer && _rxBuffer->eof()) {
+        // the peer only stopped sending, answering it is still possible
+        return buffered();
+    }
+    // a send or recv that moved data proves the link as well as the probe
+    uint32_t last = conn_staus;
+    if (_rxBuffer && (int32_t)(_rxBuffer->lastRecv() - last) > 0) {
+        last = _rxBuffer->lastRecv();
+    }
+    uint32_t interval = millis() - last;
+    if (interval > WIFI_CLIENT_KEEPALIVE_TIMEOUT) {
         uint8_t dummy;
         int res = recv(fd(), &dummy, 0, MSG_DONTWAIT);
         // avoid unused var warning by gcc
@@ -511,7 +1510,7 @@ uint8_t WiFiClient::connected()
                 break;
         }
     }
-    return _connected;
+    return _connected || buffered();
 }
 
 IPAddress WiFiClient::remoteIP(int fd) const
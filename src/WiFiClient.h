@@ -26,9 +26,86 @@
 #undef max
 #undef min
 #include <memory>
+#include <functional>
 
 class WiFiClientSocketHandle;
 class WiFiClientRxBuffer;
+class WiFiClientTxBuffer;
+class WiFiClientConnectLookup;
+
+/**
+ * socket options applied together at connect/accept time.
+ * only options that were set are applied, and options a socket
+ * already has are skipped, every setsockopt is a round trip.
+ * options the stack does not have are skipped with a warning
+ */
+class WiFiSocketProfile
+{
+public:
+    WiFiSocketProfile();
+
+    WiFiSocketProfile & setNoDelay(bool nodelay);
+    WiFiSocketProfile & setKeepAlive(bool enable);
+    WiFiSocketProfile & setKeepAliveParams(int idle, int interval, int count);
+    WiFiSocketProfile & setTimeout(uint32_t ms);
+    WiFiSocketProfile & setRecvTimeout(uint32_t ms);
+    WiFiSocketProfile & setSendTimeout(uint32_t ms);
+    WiFiSocketProfile & setRecvBufferSize(int bytes);
+    WiFiSocketProfile & setSendBufferSize(int bytes);
+
+    void merge(const WiFiSocketProfile &other);
+    int apply(int fd, WiFiSocketProfile &state) const;
+    bool getNoDelay(bool &nodelay) const;
+
+    /// what a new socket starts with
+    static WiFiSocketProfile defaults();
+
+protected:
+    enum {
+        OPT_NODELAY     = 0x001,
+        OPT_KEEPALIVE   = 0x002,
+        OPT_KEEPIDLE    = 0x004,
+        OPT_KEEPINTVL   = 0x008,
+        OPT_KEEPCNT     = 0x010,
+        OPT_RCVTIMEO    = 0x020,
+        OPT_SNDTIMEO    = 0x040,
+        OPT_RCVBUF      = 0x080,
+        OPT_SNDBUF      = 0x100
+    };
+
+    uint16_t _set;
+    int _noDelay;
+    int _keepAlive;
+    int _keepIdle;
+    int _keepInterval;
+    int _keepCount;
+    uint32_t _rcvTimeout;
+    uint32_t _sndTimeout;
+    int _rcvBuf;
+    int _sndBuf;
+};
+
+typedef enum {
+    WIFI_CLIENT_CONNECT_IDLE = 0,
+    WIFI_CLIENT_CONNECT_PENDING,
+    WIFI_CLIENT_CONNECT_SUCCESS,
+    WIFI_CLIENT_CONNECT_FAILED
+} wifi_client_connect_t;
+
+/// socket calls made on behalf of the caller
+typedef struct {
+    uint32_t sends;     // send() calls
+    uint32_t selects;   // lwip_select() calls waiting to write
+} wifiClientIoStats_t;
+
+/// result of the last stream transfer
+typedef struct {
+    size_t bytes;             // bytes sent
+    uint32_t duration;        // ms
+    uint32_t sends;           // send() calls
+    uint32_t waits;           // times the socket was full
+    uint32_t bytesPerSecond;
+} wifiClientTransferStats_t;
 
 class ESPLwIPClient : public Client
 {
@@ -40,10 +117,41 @@ public:
 
 class WiFiClient : public ESPLwIPClient
 {
+public:
+    typedef std::function<void(WiFiClient &client, int error)> ConnectCallback;
+
 protected:
     std::shared_ptr<WiFiClientSocketHandle> clientSocketHandle;
     std::shared_ptr<WiFiClientRxBuffer> _rxBuffer;
     bool _connected;
+    size_t _rxBufferSize;
+    size_t _txBufferSize;
+    uint32_t _txFlushDelay;
+    wifiClientIoStats_t _ioStats = {};
+    wifiClientTransferStats_t _transferStats = {};
+
+    /// connectAsync() in progress
+    std::shared_ptr<WiFiClientSocketHandle> _pendingSocket;
+    std::shared_ptr<WiFiClientConnectLookup> _connectLookup;
+    wifi_client_connect_t _connectState = WIFI_CLIENT_CONNECT_IDLE;
+    int _connectError = 0;
+    uint32_t _connectStart = 0;
+    int32_t _connectTimeout = -1;
+    ConnectCallback _connectCallback;
+
+    WiFiSocketProfile _socketProfile;
+
+    size_t writeDirect(const uint8_t *buf, size_t size);
+    bool flushTxBuffer();
+    size_t txPending();
+    size_t takeTxBuffer(uint8_t *buf, size_t size);
+    void discardTxBuffer();
+    void flushIfDue();
+    size_t transfer(Stream &stream, size_t max, uint32_t idleTimeout);
+    static int connectStart(IPAddress ip, uint16_t port);
+    int connectFinish(int sockfd);
+    void attach(int sockfd);
+    void forgetSocketState();
 
 public:
     WiFiClient *next;
@@ -54,10 +162,17 @@ public:
     int connect(IPAddress ip, uint16_t port, int32_t timeout);
     int connect(const char *host, uint16_t port);
     int connect(const char *host, uint16_t port, int32_t timeout);
+    int connectAsync(IPAddress ip, uint16_t port, int32_t timeout = -1);
+    int connectAsync(const char *host, uint16_t port, int32_t timeout = -1);
+    wifi_client_connect_t connectPoll();
+    int connectError();
+    void onConnect(ConnectCallback callback);
     size_t write(uint8_t data);
     size_t write(const uint8_t *buf, size_t size);
     size_t write_P(PGM_P buf, size_t size);
     size_t write(Stream &stream);
+    size_t transferFrom(Stream &stream, size_t max = SIZE_MAX);
+    const wifiClientTransferStats_t & getTransferStats();
     int available();
     int read();
     int read(uint8_t *buf, size_t size);
@@ -66,6 +181,20 @@ public:
     void clear();
     void stop();
     uint8_t connected();
+    virtual int waitAvailable(uint32_t timeout);
+
+    // direct access to the receive buffer
+    virtual size_t peekAvailable();
+    virtual const uint8_t * peekBuffer();
+    virtual void peekConsume(size_t consume);
+
+    bool setRxBufferSize(size_t size);
+    size_t getRxBufferSize();
+    void setTxBufferSize(size_t size);
+    size_t getTxBufferSize();
+    void setTxFlushDelay(uint32_t ms);
+    const wifiClientIoStats_t & getIoStats();
+    void resetIoStats();
 
     operator bool()
     {
@@ -93,6 +222,8 @@ public:
     int getOption(int option, int *value);
     int setTimeout(uint32_t seconds);
     int setNoDelay(bool nodelay);
+    int setSocketProfile(const WiFiSocketProfile &profile);
+    const WiFiSocketProfile & getSocketProfile();
     bool getNoDelay();
 
     IPAddress remoteIP() const;
@@ -104,7 +235,7 @@ public:
     uint16_t localPort() const;
     uint16_t localPort(int fd) const;
 
-    //friend class WiFiServer;
+    friend class WiFiServer;
     using Print::write;
     uint32_t conn_staus; // Check the connection status every 3S 
 };
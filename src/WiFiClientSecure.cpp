@@ -163,6 +163,16 @@ public:
         else
             return r_available();
     }
+
+    const uint8_t *peekBuffer()
+    {
+        return _buffer + _pos;
+    }
+
+    void peekConsume(size_t len)
+    {
+        _pos += (len > _fill - _pos) ? (_fill - _pos) : len;
+    }
 };
 
 WiFiClientSecure::WiFiClientSecure()
@@ -395,6 +405,48 @@ int WiFiClientSecure::available()
     return res;
 }
 
+size_t WiFiClientSecure::peekAvailable()
+{
+    return available();
+}
+
+const uint8_t *WiFiClientSecure::peekBuffer()
+{
+    if (!_rxBuffer)
+    {
+        return NULL;
+    }
+    return _rxBuffer->peekBuffer();
+}
+
+void WiFiClientSecure::peekConsume(size_t consume)
+{
+    if (_rxBuffer)
+    {
+        _rxBuffer->peekConsume(consume);
+    }
+}
+
+int WiFiClientSecure::waitAvailable(uint32_t timeout)
+{
+    int res = available();
+    if (res > 0 || !_connected || _socket < 0)
+    {
+        return res;
+    }
+    fd_set set;
+    struct timeval tv;
+    FD_ZERO(&set);
+    FD_SET(_socket, &set);
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    if (lwip_select(_socket + 1, &set, NULL, NULL, &tv) <= 0)
+    {
+        return 0;
+    }
+    return available();
+}
+
 uint8_t WiFiClientSecure::connected()
 {
 
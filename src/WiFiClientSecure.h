@@ -68,6 +68,10 @@ public:
     void flush() {}
     void stop();
     uint8_t connected();
+    int waitAvailable(uint32_t timeout);
+    size_t peekAvailable();
+    const uint8_t *peekBuffer();
+    void peekConsume(size_t consume);
     int lastError(char *buf, const size_t size);
     void setPreSharedKey(const char *pskIdent, const char *psKey); // psKey in Hex
     void setCACert(const char *rootCA);
@@ -44,6 +44,7 @@ extern "C"
 // static xQueueHandle _network_event_queue;
 // static TaskHandle_t _network_event_task_handle = NULL;
 static EventGroupHandle_t _network_event_group = NULL;
+static SemaphoreHandle_t _dns_cache_lock = NULL;
 
 wifi_mode_t WiFiGenericClass::_wifi_mode = WIFI_MODE_NULL;
 wifi_power_t WiFiGenericClass::_wifi_power = WIFI_POWER_19_5dBm;
@@ -719,19 +720,336 @@ wifi_power_t WiFiGenericClass::getTxPower()
 // ------------------------------------------------ Generic Network function ---------------------------------------------
 // -----------------------------------------------------------------------------------------------------------------------
 
+struct DnsCacheEntry
+{
+    String host;
+    IPAddress ip;           // 0.0.0.0 caches a failed lookup
+    bool refreshing;        // prefetch in flight
+    uint32_t stored;
+    uint32_t used;
+};
+
+static DnsCacheEntry _dns_cache[WIFI_DNS_CACHE_SIZE];
+static uint32_t _dns_cache_ttl = WIFI_DNS_CACHE_TTL;
+static uint32_t _dns_cache_negative_ttl = WIFI_DNS_CACHE_NEGATIVE_TTL;
+static wifiDnsStats_t _dns_stats;
+
+static bool dnsCacheLock()
+{
+    SemaphoreHandle_t lock = __atomic_load_n(&_dns_cache_lock, __ATOMIC_ACQUIRE);
+    if (!lock)
+    {
+        // tasks resolving at the same time may both get here, only one mutex is kept
+        SemaphoreHandle_t created = xSemaphoreCreateMutex();
+        if (!created)
+        {
+            return false;
+        }
+        if (__atomic_compare_exchange_n(&_dns_cache_lock, &lock, created, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            lock = created;
+        }
+        else
+        {
+            vSemaphoreDelete(created);
+        }
+    }
+    return xSemaphoreTake(lock, portMAX_DELAY) == pdTRUE;
+}
+
+static void dnsCacheUnlock()
+{
+    xSemaphoreGive(_dns_cache_lock);
+}
+
+static uint32_t dnsCacheTtl(const DnsCacheEntry &entry)
+{
+    return (uint32_t)entry.ip ? _dns_cache_ttl : _dns_cache_negative_ttl;
+}
+
+static DnsCacheEntry *dnsCacheFind(const char *aHostname)
+{
+    for (size_t i = 0; i < WIFI_DNS_CACHE_SIZE; i++)
+    {
+        if (_dns_cache[i].host.length() && _dns_cache[i].host.equalsIgnoreCase(aHostname))
+        {
+            return &_dns_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * store a lookup result, replacing the entry of the same name, else an
+ * empty or expired one, else the least recently used one.
+ * Call with the cache locked.
+ */
+static void dnsCacheStore(const char *aHostname, IPAddress aResult)
+{
+    DnsCacheEntry *slot = dnsCacheFind(aHostname);
+    if (!slot)
+    {
+        uint32_t now = millis();
+        slot = &_dns_cache[0];
+        for (size_t i = 0; i < WIFI_DNS_CACHE_SIZE; i++)
+        {
+            DnsCacheEntry &entry = _dns_cache[i];
+            if (!entry.host.length() || (now - entry.stored) >= dnsCacheTtl(entry))
+            {
+                slot = &entry;
+                break;
+            }
+            if ((now - entry.used) > (now - slot->used))
+            {
+                slot = &entry;
+            }
+        }
+        if (slot->host.length() && (now - slot->stored) < dnsCacheTtl(*slot))
+        {
+            _dns_stats.evictions++;
+        }
+        slot->host = aHostname;
+        slot->used = now;
+    }
+    slot->ip = aResult;
+    slot->refreshing = false;
+    slot->stored = millis();
+}
+
+static void wifi_dns_prefetch_callback(const char *name, const ip_addr_t *ipaddr, void *callback_arg)
+{
+    if (!dnsCacheLock())
+    {
+        return;
+    }
+    DnsCacheEntry *entry = dnsCacheFind(name);
+    if (entry)
+    {
+        entry->refreshing = false;
+        if (ipaddr && ipaddr->u_addr.ip4.addr)
+        {
+            IPAddress ip(ipaddr->u_addr.ip4.addr);
+            // the entry stays as it is when the address did not change
+            if (entry->ip == ip)
+            {
+                entry->stored = millis();
+            }
+            else
+            {
+                dnsCacheStore(name, ip);
+            }
+        }
+    }
+    dnsCacheUnlock();
+}
+
+/**
+ * refresh an entry in the background, lwip calls back when the answer is in
+ */
+static void dnsCachePrefetch(const char *aHostname)
+{
+    ip_addr_t addr;
+    err_t err = dns_gethostbyname(aHostname, &addr, &wifi_dns_prefetch_callback, NULL);
+    if (err != ERR_INPROGRESS)
+    {
+        wifi_dns_prefetch_callback(aHostname, err == ERR_OK ? &addr : NULL, NULL);
+    }
+}
+
+/**
+ * look a name up in the cache, entries in the last eighth of their
+ * lifetime are refreshed in the background so busy names never expire
+ * @return 1 if cached, 0 for a cached failure, -1 if not cached
+ */
+static int dnsCacheLookup(const char *aHostname, IPAddress &aResult)
+{
+    int found = -1;
+    bool prefetch = false;
+    if (!_dns_cache_ttl || !dnsCacheLock())
+    {
+        return -1;
+    }
+    DnsCacheEntry *entry = dnsCacheFind(aHostname);
+    uint32_t now = millis();
+    uint32_t ttl = entry ? dnsCacheTtl(*entry) : 0;
+    if (entry && (now - entry->stored) < ttl)
+    {
+        entry->used = now;
+        aResult = entry->ip;
+        found = (uint32_t)aResult != 0;
+        if (found)
+        {
+            _dns_stats.hits++;
+            if (!entry->refreshing && (now - entry->stored) >= ttl - ttl / 8)
+            {
+                entry->refreshing = true;
+                prefetch = true;
+                _dns_stats.prefetches++;
+            }
+        }
+        else
+        {
+            _dns_stats.negativeHits++;
+        }
+    }
+    else
+    {
+        _dns_stats.misses++;
+    }
+    dnsCacheUnlock();
+    if (prefetch)
+    {
+        dnsCachePrefetch(aHostname);
+    }
+    return found;
+}
+
+/**
+ * cache the outcome of resolving a miss and account for the time it took
+ */
+static void dnsCacheResolved(const char *aHostname, IPAddress aResult, uint32_t started, bool store = true)
+{
+    uint32_t elapsed = millis() - started;
+    if (!dnsCacheLock())
+    {
+        return;
+    }
+    _dns_stats.lookupTime += elapsed;
+    if (elapsed > _dns_stats.maxLookupTime)
+    {
+        _dns_stats.maxLookupTime = elapsed;
+    }
+    if (!(uint32_t)aResult)
+    {
+        _dns_stats.failures++;
+    }
+    if (_dns_cache_ttl && store)
+    {
+        dnsCacheStore(aHostname, aResult);
+    }
+    dnsCacheUnlock();
+}
+
+/**
+ * one outstanding dns_gethostbyname(), so lookups of different names
+ * complete independently. A blocking lookup waits on done, which is
+ * shared with the DNS callback until both dropped their reference;
+ * an async one has no waiter and ends in callback.
+ */
+struct DnsRequest
+{
+    SemaphoreHandle_t done;
+    WiFiDnsResultCb callback;
+    String host;
+    IPAddress result;
+    uint32_t started;
+    uint8_t refs;
+    bool answered;          // the DNS callback ran
+    bool abandoned;         // the waiter timed out, the callback caches the answer
+};
+
+static void dnsRequestRelease(DnsRequest *request)
+{
+    // without the lock the other side may still use it, leak it instead
+    bool last = false;
+    if (dnsCacheLock())
+    {
+        last = --request->refs == 0;
+        dnsCacheUnlock();
+    }
+    if (last)
+    {
+        vSemaphoreDelete(request->done);
+        delete request;
+    }
+}
+
+static void dnsRequestComplete(DnsRequest *request, IPAddress aResult)
+{
+    if ((uint32_t)aResult == 0)
+    {
+        log_e("DNS Failed for %s", request->host.c_str());
+    }
+    dnsCacheResolved(request->host.c_str(), aResult, request->started);
+    request->callback(request->host.c_str(), aResult);
+    delete request;
+}
+
 /**
  * DNS callback
  * @param name
  * @param ipaddr
- * @param callback_arg
+ * @param callback_arg  the DnsRequest
  */
 static void wifi_dns_found_callback(const char *name, const ip_addr_t *ipaddr, void *callback_arg)
 {
-    if (ipaddr)
+    DnsRequest *request = reinterpret_cast<DnsRequest *>(callback_arg);
+    IPAddress result(ipaddr ? ipaddr->u_addr.ip4.addr : 0);
+    if (!request->done)
+    {
+        dnsRequestComplete(request, result);
+        return;
+    }
+    // given under the lock, a waiter that timed out may free the request right after
+    if (dnsCacheLock())
+    {
+        request->result = result;
+        request->answered = true;
+        if (request->abandoned && (uint32_t)result && _dns_cache_ttl)
+        {
+            dnsCacheStore(request->host.c_str(), result);
+        }
+        xSemaphoreGive(request->done);
+        dnsCacheUnlock();
+    }
+    dnsRequestRelease(request);
+}
+
+/**
+ * resolve a name that is not cached with its own DnsRequest and cache the outcome
+ * @return 1 if resolved, else 0
+ */
+static int dnsResolve(const char *aHostname, IPAddress &aResult)
+{
+    ip_addr_t addr;
+    aResult = static_cast<uint32_t>(0);
+    uint32_t started = millis();
+    DnsRequest *request = new DnsRequest();
+    request->done = xSemaphoreCreateBinary();
+    if (!request->done)
     {
-        (*reinterpret_cast<IPAddress *>(callback_arg)) = ipaddr->u_addr.ip4.addr;
+        log_e("DNS request for %s could not be created", aHostname);
+        delete request;
+        return 0;
+    }
+    request->host = aHostname;
+    request->refs = 2;
+    bool timedOut = false;
+    err_t err = dns_gethostbyname(aHostname, &addr, &wifi_dns_found_callback, request);
+    if(err == ERR_INPROGRESS) {
+        xSemaphoreTake(request->done, 4000 / portTICK_PERIOD_MS);
+        if (dnsCacheLock())
+        {
+            aResult = request->result;
+            // a slow answer is not a failure, leave it to the callback to cache
+            timedOut = !request->answered;
+            request->abandoned = timedOut;
+            dnsCacheUnlock();
+        }
+        dnsRequestRelease(request);
+    } else {
+        if(err == ERR_OK && addr.u_addr.ip4.addr) {
+            aResult = addr.u_addr.ip4.addr;
+        }
+        // lwip does not call back when it answered right away
+        vSemaphoreDelete(request->done);
+        delete request;
+    }
+    if((uint32_t)aResult == 0){
+        log_e("DNS %s for %s", timedOut ? "timed out" : "Failed", aHostname);
     }
-    xEventGroupSetBits(_network_event_group, WIFI_DNS_DONE_BIT);
+    dnsCacheResolved(aHostname, aResult, started, !timedOut);
+    return (uint32_t)aResult != 0;
 }
 
 /**
@@ -743,22 +1061,93 @@ static void wifi_dns_found_callback(const char *name, const ip_addr_t *ipaddr, v
  */
 int WiFiGenericClass::hostByName(const char *aHostname, IPAddress &aResult)
 {
-    ip_addr_t addr;
     aResult = static_cast<uint32_t>(0);
-    waitStatusBits(WIFI_DNS_IDLE_BIT, 5000);
-    clearStatusBits(WIFI_DNS_IDLE_BIT);
-    err_t err = dns_gethostbyname(aHostname, &addr, &wifi_dns_found_callback, &aResult);
-    if(err == ERR_OK && addr.u_addr.ip4.addr) {
-        aResult = addr.u_addr.ip4.addr;
-    } else if(err == ERR_INPROGRESS) {
-        waitStatusBits(WIFI_DNS_DONE_BIT, 4000);
-        clearStatusBits(WIFI_DNS_DONE_BIT);
-    }
-    setStatusBits(WIFI_DNS_IDLE_BIT);
-    if((uint32_t)aResult == 0){
-        log_e("DNS Failed for %s", aHostname);
+    int cached = dnsCacheLookup(aHostname, aResult);
+    if (cached >= 0)
+    {
+        return cached;
     }
-    return (uint32_t)aResult != 0;
+    return dnsResolve(aHostname, aResult);
+}
+
+/**
+ * Resolve the given hostname without waiting for the answer.
+ * The callback gets 0.0.0.0 if the name could not be resolved. It runs
+ * right away for cached names and answers lwip already has, else from
+ * the DNS callback, so it should not block.
+ * @param aHostname     Name to be resolved
+ * @param callback      called once with the result
+ * @return 1 if the callback was or will be called, 0 if the lookup could not be started
+ */
+int WiFiGenericClass::hostByName(const char *aHostname, WiFiDnsResultCb callback)
+{
+    ip_addr_t addr;
+    IPAddress result;
+    if (!aHostname || !callback)
+    {
+        return 0;
+    }
+    if (dnsCacheLookup(aHostname, result) >= 0)
+    {
+        callback(aHostname, result);
+        return 1;
+    }
+    DnsRequest *request = new DnsRequest();
+    request->done = NULL;
+    request->callback = callback;
+    request->host = aHostname;
+    request->started = millis();
+    err_t err = dns_gethostbyname(aHostname, &addr, &wifi_dns_found_callback, request);
+    if (err == ERR_INPROGRESS)
+    {
+        return 1;
+    }
+    if (err != ERR_OK)
+    {
+        log_e("DNS lookup of %s could not be started: %d", aHostname, err);
+        delete request;
+        return 0;
+    }
+    dnsRequestComplete(request, IPAddress(addr.u_addr.ip4.addr));
+    return 1;
+}
+
+/**
+ * Set how long hostByName() reuses a resolved address or a failed lookup.
+ * The DNS callback does not pass on the record's TTL, so this bounds it instead.
+ * @param ttl           lifetime of addresses in ms, 0 disables and empties the cache
+ * @param negativeTtl   lifetime of failures in ms, 0 does not cache failures
+ */
+void WiFiGenericClass::setDnsCacheTtl(uint32_t ttl, uint32_t negativeTtl)
+{
+    if (!dnsCacheLock())
+    {
+        return;
+    }
+    _dns_cache_ttl = ttl;
+    _dns_cache_negative_ttl = negativeTtl;
+    for (size_t i = 0; i < WIFI_DNS_CACHE_SIZE; i++)
+    {
+        if (!ttl || !(uint32_t)_dns_cache[i].ip)
+        {
+            _dns_cache[i].host = String();
+        }
+    }
+    dnsCacheUnlock();
+}
+
+/**
+ * @return hit, miss and latency counters of the hostByName() cache
+ */
+wifiDnsStats_t WiFiGenericClass::getDnsStats()
+{
+    wifiDnsStats_t stats = {};
+    if (dnsCacheLock())
+    {
+        stats = _dns_stats;
+        dnsCacheUnlock();
+    }
+    return stats;
 }
 
 IPAddress WiFiGenericClass::calculateNetworkID(IPAddress ip, IPAddress subnet)
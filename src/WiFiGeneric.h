@@ -35,6 +35,7 @@ int htoi(const char *s);
 typedef void (*WiFiEventCb)(system_event_id_t event);
 typedef std::function<void(system_event_id_t event, system_event_info_t info)> WiFiEventFuncCb;
 typedef void (*WiFiEventSysCb)(system_event_t *event);
+typedef std::function<void(const char *aHostname, IPAddress aResult)> WiFiDnsResultCb;
 
 typedef size_t wifi_event_id_t;
 
@@ -69,6 +70,30 @@ static const int WIFI_SCAN_DONE_BIT= BIT12;
 static const int WIFI_DNS_IDLE_BIT = BIT13;
 static const int WIFI_DNS_DONE_BIT = BIT14;
 
+/// resolved host names kept by hostByName()
+#ifndef WIFI_DNS_CACHE_SIZE
+#define WIFI_DNS_CACHE_SIZE (8)
+#endif
+/// default lifetime of a cached host name in ms
+#ifndef WIFI_DNS_CACHE_TTL
+#define WIFI_DNS_CACHE_TTL (60000)
+#endif
+/// default lifetime of a cached lookup failure in ms
+#ifndef WIFI_DNS_CACHE_NEGATIVE_TTL
+#define WIFI_DNS_CACHE_NEGATIVE_TTL (10000)
+#endif
+
+typedef struct {
+    uint32_t hits;          // answered from the cache
+    uint32_t negativeHits;  // answered with a cached failure
+    uint32_t misses;        // had to be resolved
+    uint32_t failures;      // resolutions that found no address
+    uint32_t prefetches;    // entries refreshed in the background before expiring
+    uint32_t evictions;     // live entries replaced to make room
+    uint32_t lookupTime;    // ms spent resolving misses, divide by misses for the mean
+    uint32_t maxLookupTime; // slowest resolution in ms
+} wifiDnsStats_t;
+
 class WiFiGenericClass
 {
   public:
@@ -113,6 +138,9 @@ class WiFiGenericClass
 
   public:
     static int hostByName(const char *aHostname, IPAddress &aResult);
+    static int hostByName(const char *aHostname, WiFiDnsResultCb callback);
+    static void setDnsCacheTtl(uint32_t ttl, uint32_t negativeTtl = WIFI_DNS_CACHE_NEGATIVE_TTL);
+    static wifiDnsStats_t getDnsStats();
 
     static IPAddress calculateNetworkID(IPAddress ip, IPAddress subnet);
     static IPAddress calculateBroadcast(IPAddress ip, IPAddress subnet);
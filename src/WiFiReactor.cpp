@@ -0,0 +1,242 @@
+/*
+  WiFiReactor.cpp - one select over many sockets with readiness callbacks
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "WiFiReactor.h"
+#include "lwip/sockets.h"
+
+WiFiReactorClass::Entry * WiFiReactorClass::find(int fd)
+{
+    if(fd < 0) {
+        return NULL;
+    }
+    for(size_t i = 0; i < _entries.size(); i++) {
+        if(_entries[i].fd == fd) {
+            return &_entries[i];
+        }
+    }
+    for(size_t i = 0; i < _added.size(); i++) {
+        if(_added[i].fd == fd) {
+            return &_added[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * register a socket, or replace events and callback if it is registered
+ * @param fd int
+ * @param events uint8_t    WIFI_REACTOR_READ | WIFI_REACTOR_WRITE | WIFI_REACTOR_ERROR, 0 pauses
+ * @param callback WiFiReactorCallback  gets the fd and the events that happened
+ * @return false for an invalid socket
+ */
+bool WiFiReactorClass::add(int fd, uint8_t events, WiFiReactorCallback callback)
+{
+    if(fd < 0 || !callback) {
+        return false;
+    }
+    Entry * entry = find(fd);
+    if(entry) {
+        entry->events = events;
+        entry->callback = callback;
+        return true;
+    }
+    Entry added = { fd, events, false, 0, callback };
+    // _entries must not move while its callbacks run
+    if(_dispatching) {
+        _added.push_back(added);
+    } else {
+        _entries.push_back(added);
+    }
+    return true;
+}
+
+bool WiFiReactorClass::setEvents(int fd, uint8_t events)
+{
+    Entry * entry = find(fd);
+    if(!entry) {
+        return false;
+    }
+    entry->events = events;
+    return true;
+}
+
+/**
+ * report WIFI_REACTOR_TIMEOUT for fd once ms from now, unless changed before
+ * @param ms uint32_t   0 clears the deadline
+ */
+bool WiFiReactorClass::setDeadline(int fd, uint32_t ms)
+{
+    Entry * entry = find(fd);
+    if(!entry) {
+        return false;
+    }
+    entry->hasDeadline = ms > 0;
+    entry->deadline = millis() + ms;
+    return true;
+}
+
+/**
+ * forget a socket, call before closing it
+ */
+void WiFiReactorClass::remove(int fd)
+{
+    Entry * entry = find(fd);
+    if(!entry) {
+        return;
+    }
+    // erased after the dispatch loop
+    entry->fd = -1;
+    entry->callback = nullptr;
+    if(_dispatching) {
+        return;
+    }
+    for(size_t i = 0; i < _entries.size(); i++) {
+        if(_entries[i].fd < 0) {
+            _entries.erase(_entries.begin() + i);
+            break;
+        }
+    }
+}
+
+bool WiFiReactorClass::contains(int fd)
+{
+    return find(fd) != NULL;
+}
+
+size_t WiFiReactorClass::size()
+{
+    return _entries.size() + _added.size();
+}
+
+/**
+ * wait for the registered sockets with one select and run the callbacks
+ * of those that are ready or whose deadline passed
+ * @param timeout uint32_t  max ms to wait, 0 only checks
+ * @return number of callbacks run, -1 on select error
+ */
+int WiFiReactorClass::poll(uint32_t timeout)
+{
+    fd_set rset, wset, eset;
+    int maxfd = -1;
+    uint32_t now = millis();
+    uint32_t wait = timeout;
+    int res = 0;
+
+    _stats.polls++;
+    FD_ZERO(&rset);
+    FD_ZERO(&wset);
+    FD_ZERO(&eset);
+    for(size_t i = 0; i < _entries.size(); i++) {
+        Entry &entry = _entries[i];
+        if(entry.fd < 0) {
+            continue;
+        }
+        if(entry.events & WIFI_REACTOR_READ) {
+            FD_SET(entry.fd, &rset);
+        }
+        if(entry.events & WIFI_REACTOR_WRITE) {
+            FD_SET(entry.fd, &wset);
+        }
+        if(entry.events & WIFI_REACTOR_ERROR) {
+            FD_SET(entry.fd, &eset);
+        }
+        if((entry.events & (WIFI_REACTOR_READ | WIFI_REACTOR_WRITE | WIFI_REACTOR_ERROR)) && entry.fd > maxfd) {
+            maxfd = entry.fd;
+        }
+        if(entry.hasDeadline) {
+            int32_t left = entry.deadline - now;
+            if(left < 0) {
+                left = 0;
+            }
+            if((uint32_t)left < wait) {
+                wait = left;
+            }
+        }
+    }
+
+    if(maxfd >= 0) {
+        struct timeval tv;
+        tv.tv_sec = wait / 1000;
+        tv.tv_usec = (wait % 1000) * 1000;
+        _stats.selects++;
+        res = lwip_select(maxfd + 1, &rset, &wset, &eset, &tv);
+        if(res < 0) {
+            log_e("select errno: %d, \"%s\"", errno, strerror(errno));
+            return -1;
+        }
+    } else if(wait) {
+        delay(wait);
+    }
+
+    int dispatched = 0;
+    now = millis();
+    _dispatching = true;
+    for(size_t i = 0; i < _entries.size(); i++) {
+        Entry &entry = _entries[i];
+        if(entry.fd < 0) {
+            continue;
+        }
+        uint8_t events = 0;
+        if(res > 0) {
+            if((entry.events & WIFI_REACTOR_READ) && FD_ISSET(entry.fd, &rset)) {
+                events |= WIFI_REACTOR_READ;
+            }
+            if((entry.events & WIFI_REACTOR_WRITE) && FD_ISSET(entry.fd, &wset)) {
+                events |= WIFI_REACTOR_WRITE;
+            }
+            if((entry.events & WIFI_REACTOR_ERROR) && FD_ISSET(entry.fd, &eset)) {
+                events |= WIFI_REACTOR_ERROR;
+            }
+        }
+        if(entry.hasDeadline && (int32_t)(now - entry.deadline) >= 0) {
+            entry.hasDeadline = false;
+            events |= WIFI_REACTOR_TIMEOUT;
+        }
+        if(events) {
+            dispatched++;
+            // the callback may replace or remove the entry
+            WiFiReactorCallback callback = entry.callback;
+            callback(entry.fd, events);
+        }
+    }
+    _dispatching = false;
+
+    for(size_t i = 0; i < _entries.size();) {
+        if(_entries[i].fd < 0) {
+            _entries.erase(_entries.begin() + i);
+        } else {
+            i++;
+        }
+    }
+    for(size_t i = 0; i < _added.size(); i++) {
+        if(_added[i].fd >= 0) {
+            _entries.push_back(_added[i]);
+        }
+    }
+    _added.clear();
+
+    _stats.dispatched += dispatched;
+    return dispatched;
+}
+
+const wifiReactorStats_t & WiFiReactorClass::getStats()
+{
+    return _stats;
+}
+
+WiFiReactorClass WiFiReactor;
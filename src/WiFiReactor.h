@@ -0,0 +1,79 @@
+/*
+  WiFiReactor.h - one select over many sockets with readiness callbacks
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _WIFIREACTOR_H_
+#define _WIFIREACTOR_H_
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+
+typedef enum {
+    WIFI_REACTOR_READ    = 0x01,
+    WIFI_REACTOR_WRITE   = 0x02,
+    WIFI_REACTOR_ERROR   = 0x04,
+    WIFI_REACTOR_TIMEOUT = 0x08     // deadline set with setDeadline() passed
+} wifi_reactor_event_t;
+
+typedef struct {
+    uint32_t polls;       // poll() calls
+    uint32_t selects;     // lwip_select calls made by poll()
+    uint32_t dispatched;  // callbacks run
+} wifiReactorStats_t;
+
+typedef std::function<void(int fd, uint8_t events)> WiFiReactorCallback;
+
+/**
+ * sockets register the events they wait for, poll() checks all of them
+ * with a single select and runs the callbacks of the ready ones.
+ * callbacks may add, change or remove entries, also their own
+ */
+class WiFiReactorClass
+{
+public:
+    bool add(int fd, uint8_t events, WiFiReactorCallback callback);
+    bool setEvents(int fd, uint8_t events);
+    bool setDeadline(int fd, uint32_t ms);
+    void remove(int fd);
+    bool contains(int fd);
+    size_t size();
+
+    int poll(uint32_t timeout = 0);
+
+    const wifiReactorStats_t & getStats();
+
+protected:
+    struct Entry {
+        int fd;
+        uint8_t events;
+        bool hasDeadline;
+        uint32_t deadline;
+        WiFiReactorCallback callback;
+    };
+
+    Entry * find(int fd);
+
+    std::vector<Entry> _entries;
+    std::vector<Entry> _added;  // added while dispatching
+    bool _dispatching = false;
+    wifiReactorStats_t _stats = {};
+};
+
+extern WiFiReactorClass WiFiReactor;
+
+#endif /* _WIFIREACTOR_H_ */
@@ -33,36 +33,260 @@ int WiFiServer::setTimeout(uint32_t seconds){
   return setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, (char *)&tv, sizeof(struct timeval));
 }
 
+/**
+ * keep every client returned by available() in the server, so write()
+ * reaches all of them. Clients are forgotten once they disconnect or the
+ * application drops its last copy, so keep the client while it should
+ * receive. Writing to a tracked client directly as well is not supported,
+ * those bytes can overtake what write() still holds in its backlog.
+ * @param enable bool
+ */
+void WiFiServer::trackClients(bool enable){
+  _trackClients = enable;
+}
+
+/**
+ * add a client to the ones reached by write()
+ * @param client const WiFiClient&
+ * @return false if the client is not connected or max_clients are tracked already
+ */
+bool WiFiServer::addClient(const WiFiClient &client){
+  int fd = client.fd();
+  if(fd < 0){
+    return false;
+  }
+  for(size_t i = 0; i < _clients.size(); i++){
+    if(_clients[i].client.fd() == fd){
+      return true;
+    }
+  }
+  pruneClients();
+  if(_clients.size() >= _max_clients){
+    log_w("already tracking %u clients", _clients.size());
+    return false;
+  }
+  _clients.push_back({ client, NULL, 0 });
+  return true;
+}
+
+/**
+ * @return number of tracked clients still connected
+ */
+size_t WiFiServer::clientCount(){
+  pruneClients();
+  return _clients.size();
+}
+
+/**
+ * set how far a tracked client may fall behind write() and what happens
+ * to it when it falls further
+ * @param bytes size_t  unsent bytes kept per client
+ * @param overflow wifi_server_overflow_t
+ */
+void WiFiServer::setClientBacklog(size_t bytes, wifi_server_overflow_t overflow){
+  for(size_t i = _clients.size(); i > 0; i--){
+    TrackedClient &entry = _clients[i - 1];
+    if(entry.pending > bytes){
+      _stats.dropped++;
+      removeClient(i - 1, true);
+    } else if(entry.pending){
+      uint8_t * backlog = (uint8_t *)realloc(entry.backlog, bytes);
+      if(backlog){
+        entry.backlog = backlog;
+      } else {
+        log_e("Not enough memory to allocate backlog");
+        _stats.dropped++;
+        removeClient(i - 1, true);
+      }
+    } else {
+      free(entry.backlog);
+      entry.backlog = NULL;
+    }
+  }
+  _clientBacklog = bytes;
+  _overflow = overflow;
+}
+
+/**
+ * forget a tracked client
+ * @param index size_t
+ * @param disconnect bool  also close the connection for the application's copies
+ */
+void WiFiServer::removeClient(size_t index, bool disconnect){
+  WiFiClient &client = _clients[index].client;
+  if(disconnect && client.fd() >= 0){
+    // a client dropped for being slow would block the caller on its buffered data
+    client.discardTxBuffer();
+    shutdown(client.fd(), SHUT_RDWR);
+  }
+  client.stop();
+  free(_clients[index].backlog);
+  _clients.erase(_clients.begin() + index);
+}
+
+/**
+ * forget clients the application let go of, and the ones that disconnected
+ */
+void WiFiServer::pruneClients(){
+  for(size_t i = _clients.size(); i > 0; i--){
+    WiFiClient &client = _clients[i - 1].client;
+    if(client.clientSocketHandle.use_count() <= 1 || !client.connected()){
+      removeClient(i - 1, false);
+    }
+  }
+}
+
+bool WiFiServer::reserveBacklog(TrackedClient &entry){
+  if(!entry.backlog && _clientBacklog){
+    entry.backlog = (uint8_t *)malloc(_clientBacklog);
+    if(!entry.backlog){
+      log_e("Not enough memory to allocate backlog");
+    }
+  }
+  return entry.backlog != NULL;
+}
+
+/**
+ * send as much of the client's backlog as the socket takes without blocking.
+ * What the application wrote through the client's tx buffer came after the
+ * backlog, it is moved to its end as far as there is room and sent the same way.
+ * @return false if the connection failed
+ */
+bool WiFiServer::sendBacklog(TrackedClient &entry){
+  while(true){
+    if(entry.client.txPending() && entry.pending < _clientBacklog && reserveBacklog(entry)){
+      entry.pending += entry.client.takeTxBuffer(entry.backlog + entry.pending, _clientBacklog - entry.pending);
+    }
+    if(!entry.pending){
+      return true;
+    }
+    int res = send(entry.client.fd(), entry.backlog, entry.pending, MSG_DONTWAIT);
+    if(res < 0){
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    entry.pending -= res;
+    memmove(entry.backlog, entry.backlog + res, entry.pending);
+    if(!res || !entry.client.txPending()){
+      return true;
+    }
+  }
+}
+
+bool WiFiServer::queueBacklog(TrackedClient &entry, const uint8_t *data, size_t len){
+  if(entry.pending + len > _clientBacklog || !reserveBacklog(entry)){
+    return false;
+  }
+  memcpy(entry.backlog + entry.pending, data, len);
+  entry.pending += len;
+  return true;
+}
+
+/**
+ * send the same buffer to every tracked client without blocking on any of them.
+ * Whatever a client's socket does not take is kept in its backlog; a client
+ * with no room left misses the payload or is disconnected (setClientBacklog).
+ * A payload that was partly sent is never skipped, the client is dropped
+ * instead, so every client sees whole payloads in order.
+ * @return len if at least one client got or queued the data, 0 otherwise
+ */
 size_t WiFiServer::write(const uint8_t *data, size_t len){
-  return 0;
+  bool delivered = false;
+  if(!len){
+    return 0;
+  }
+  _stats.broadcasts++;
+  pruneClients();
+  for(size_t i = _clients.size(); i > 0; i--){
+    TrackedClient &entry = _clients[i - 1];
+    size_t sent = 0;
+    bool ok = sendBacklog(entry);
+    // tx data that did not fit the backlog has to go out before the payload
+    bool behind = entry.pending || entry.client.txPending();
+    if(ok && !behind){
+      int res = send(entry.client.fd(), data, len, MSG_DONTWAIT);
+      if(res >= 0){
+        sent = res;
+      } else if(errno != EAGAIN && errno != EWOULDBLOCK){
+        ok = false;
+      }
+    }
+    if(ok && (sent == len || (!entry.client.txPending() && queueBacklog(entry, data + sent, len - sent)))){
+      delivered = true;
+      continue;
+    }
+    if(ok && !sent && _overflow == WIFI_SERVER_OVERFLOW_SKIP){
+      _stats.skipped++;
+      continue;
+    }
+    if(ok){
+      log_w("fd %d fell behind, dropping it", entry.client.fd());
+    }
+    _stats.dropped++;
+    removeClient(i - 1, true);
+  }
+  return delivered ? len : 0;
 }
 
-void WiFiServer::stopAll(){}
+/**
+ * push the tracked clients' backlogs out as far as their sockets take without blocking
+ */
+void WiFiServer::flush(){
+  pruneClients();
+  for(size_t i = _clients.size(); i > 0; i--){
+    if(!sendBacklog(_clients[i - 1])){
+      _stats.dropped++;
+      removeClient(i - 1, true);
+    }
+  }
+}
+
+/**
+ * disconnect and forget all tracked clients, what their sockets
+ * take of the backlogs without blocking is sent first
+ */
+void WiFiServer::stopAll(){
+  for(size_t i = 0; i < _clients.size(); i++){
+    sendBacklog(_clients[i]);
+  }
+  while(!_clients.empty()){
+    removeClient(_clients.size() - 1, true);
+  }
+}
 
 WiFiClient WiFiServer::available(){
   if(!_listening)
     return WiFiClient();
-  int client_sock;
-  if (_accepted_sockfd >= 0) {
-    client_sock = _accepted_sockfd;
-    _accepted_sockfd = -1;
-  }
-  else {
-  struct sockaddr_in _client;
-  int cs = sizeof(struct sockaddr_in);
-    client_sock = lwip_accept_r(sockfd, (struct sockaddr *)&_client, (socklen_t*)&cs);
+  if(!_acceptCount)
+    acceptPending();
+  int client_sock = -1;
+  if(_acceptCount){
+    client_sock = _acceptQueue[_acceptHead];
+    _acceptHead = (_acceptHead + 1) % WIFI_SERVER_ACCEPT_QUEUE_SIZE;
+    _acceptCount--;
   }
   if(client_sock >= 0){
-    int val = 1;
-    if(setsockopt(client_sock, SOL_SOCKET, SO_KEEPALIVE, (char*)&val, sizeof(int)) == ESP_OK) {
-      val = _noDelay;
-      if(setsockopt(client_sock, IPPROTO_TCP, TCP_NODELAY, (char*)&val, sizeof(int)) == ESP_OK)
-        return WiFiClient(client_sock);
-    }
+    WiFiClient client(client_sock);
+    WiFiSocketProfile profile;
+    profile.setKeepAlive(true).setNoDelay(_noDelay);
+    profile.merge(_clientProfile);
+    // a client with some options missing still works, it is not turned away for it
+    if(client.setSocketProfile(profile) != ESP_OK)
+      log_w("socket options on fd %d could not be applied", client_sock);
+    if(_trackClients)
+      addClient(client);
+    return client;
   }
   return WiFiClient();
 }
 
+/**
+ * socket options for accepted clients, applied on top of
+ * keepalive and setNoDelay()
+ */
+void WiFiServer::setClientProfile(const WiFiSocketProfile &profile) {
+    _clientProfile.merge(profile);
+}
+
 void WiFiServer::begin(uint16_t port){
   if(_listening)
     return;
@@ -83,7 +307,8 @@ void WiFiServer::begin(uint16_t port){
   fcntl(sockfd, F_SETFL, O_NONBLOCK);
   _listening = true;
   _noDelay = false;
-  _accepted_sockfd = -1;
+  _acceptHead = 0;
+  _acceptCount = 0;
 }
 
 void WiFiServer::setNoDelay(bool nodelay) {
@@ -95,19 +320,61 @@ bool WiFiServer::getNoDelay() {
 }
 
 bool WiFiServer::hasClient() {
-    if (_accepted_sockfd >= 0) {
+    if (_acceptCount) {
       return true;
     }
-    struct sockaddr_in _client;
-    int cs = sizeof(struct sockaddr_in);
-    _accepted_sockfd = lwip_accept_r(sockfd, (struct sockaddr *)&_client, (socklen_t*)&cs);
-    if (_accepted_sockfd >= 0) {
-      return true;
+    return acceptPending() > 0;
+}
+
+/**
+ * accept connections waiting in the listen backlog into the queue,
+ * a burst is taken in one go instead of one per available() call
+ * @param max int   most connections to accept
+ * @return number of connections accepted
+ */
+int WiFiServer::acceptPending(int max) {
+    int accepted = 0;
+    if (!_listening) {
+      return 0;
     }
-    return false;
+    while (accepted < max) {
+      if (_acceptCount == WIFI_SERVER_ACCEPT_QUEUE_SIZE) {
+        _stats.queueFull++;
+        break;
+      }
+      struct sockaddr_in _client;
+      int cs = sizeof(struct sockaddr_in);
+      _stats.acceptCalls++;
+      int client_sock = lwip_accept_r(sockfd, (struct sockaddr *)&_client, (socklen_t*)&cs);
+      if (client_sock < 0) {
+        if (errno != EWOULDBLOCK && errno != EAGAIN) {
+          log_e("accept on fd %d, errno: %d, \"%s\"", sockfd, errno, strerror(errno));
+          _stats.acceptErrors++;
+        }
+        break;
+      }
+      _acceptQueue[(_acceptHead + _acceptCount) % WIFI_SERVER_ACCEPT_QUEUE_SIZE] = client_sock;
+      _acceptCount++;
+      accepted++;
+    }
+    _stats.accepted += accepted;
+    if (_acceptCount > _stats.maxQueued) {
+      _stats.maxQueued = _acceptCount;
+    }
+    return accepted;
+}
+
+const wifiServerStats_t & WiFiServer::getStats() {
+    return _stats;
 }
 
 void WiFiServer::end(){
+  stopAll();
+  while (_acceptCount) {
+    lwip_close_r(_acceptQueue[_acceptHead]);
+    _acceptHead = (_acceptHead + 1) % WIFI_SERVER_ACCEPT_QUEUE_SIZE;
+    _acceptCount--;
+  }
   lwip_close_r(sockfd);
   sockfd = -1;
   _listening = false;
@@ -22,20 +22,62 @@
 #include "Arduino.h"
 #include "Server.h"
 #include "WiFiClient.h"
+#include <vector>
+
+/// accepted sockets kept until available() hands them out
+#define WIFI_SERVER_ACCEPT_QUEUE_SIZE (8)
+/// bytes a tracked client may fall behind a broadcast write()
+#define WIFI_SERVER_DEF_CLIENT_BACKLOG (1024)
+
+typedef enum {
+  WIFI_SERVER_OVERFLOW_SKIP,    // a client whose backlog is full misses the payload
+  WIFI_SERVER_OVERFLOW_DROP     // a client whose backlog is full is disconnected
+} wifi_server_overflow_t;
+
+typedef struct {
+  uint32_t accepted;      // connections accepted
+  uint32_t acceptCalls;   // accept() calls, including the ones that found nothing
+  uint32_t acceptErrors;  // accept() failures other than "nothing pending"
+  uint32_t queueFull;     // drains stopped because the queue was full
+  uint8_t maxQueued;      // highest number of sockets waiting in the queue
+  uint32_t broadcasts;    // write() calls to the tracked clients
+  uint32_t skipped;       // payloads a slow client missed
+  uint32_t dropped;       // clients disconnected for falling behind or failing
+} wifiServerStats_t;
 
 class WiFiServer : public Server {
   private:
     int sockfd;
-    int _accepted_sockfd = -1;
+    int _acceptQueue[WIFI_SERVER_ACCEPT_QUEUE_SIZE];
+    uint8_t _acceptHead = 0;
+    uint8_t _acceptCount = 0;
+    wifiServerStats_t _stats = {};
     uint16_t _port;
     uint8_t _max_clients;
     bool _listening;
     bool _noDelay = false;
+    WiFiSocketProfile _clientProfile;
+
+    struct TrackedClient {
+      WiFiClient client;
+      uint8_t * backlog;  // bytes accepted by write() but not yet sent
+      size_t pending;
+    };
+    std::vector<TrackedClient> _clients;
+    bool _trackClients = false;
+    size_t _clientBacklog = WIFI_SERVER_DEF_CLIENT_BACKLOG;
+    wifi_server_overflow_t _overflow = WIFI_SERVER_OVERFLOW_SKIP;
+
+    bool reserveBacklog(TrackedClient &entry);
+    bool sendBacklog(TrackedClient &entry);
+    bool queueBacklog(TrackedClient &entry, const uint8_t *data, size_t len);
+    void removeClient(size_t index, bool disconnect);
+    void pruneClients();
 
   public:
     void listenOnLocalhost(){}
 
-    WiFiServer(uint16_t port=80, uint8_t max_clients=4):sockfd(-1),_accepted_sockfd(-1),_port(port),_max_clients(max_clients),_listening(false),_noDelay(false){}
+    WiFiServer(uint16_t port=80, uint8_t max_clients=4):sockfd(-1),_port(port),_max_clients(max_clients),_listening(false),_noDelay(false){}
     ~WiFiServer(){ end();}
     WiFiClient available();
     WiFiClient accept(){return available();}
@@ -43,12 +85,22 @@ class WiFiServer : public Server {
     void begin() { begin(0);};
     void setNoDelay(bool nodelay);
     bool getNoDelay();
+    void setClientProfile(const WiFiSocketProfile &profile);
     bool hasClient();
+    int acceptPending(int max = WIFI_SERVER_ACCEPT_QUEUE_SIZE);
+    const wifiServerStats_t & getStats();
+    int pending() const { return _acceptCount; }
+    int fd() const { return sockfd; }
+    void trackClients(bool enable);
+    bool addClient(const WiFiClient &client);
+    size_t clientCount();
+    void setClientBacklog(size_t bytes, wifi_server_overflow_t overflow = WIFI_SERVER_OVERFLOW_SKIP);
     size_t write(const uint8_t *data, size_t len);
     size_t write(uint8_t data){
       return write(&data, 1);
     }
     using Print::write;
+    void flush();
 
     void end();
     void close();
@@ -32,10 +32,20 @@ WiFiUDP::WiFiUDP()
 , tx_buffer(0)
 , tx_buffer_len(0)
 , rx_buffer(0)
+, rx_buffer_len(0)
+, rx_buffer_pos(0)
+, rx_queue(0)
+, rx_queue_size(0)
+, rx_queue_head(0)
+, rx_queue_count(0)
+, rx_queue_deferred(false)
+, _stats()
+, _fragment(false)
 {}
 
 WiFiUDP::~WiFiUDP(){
    stop();
+   setReceiveQueue(0);
 }
 
 uint8_t WiFiUDP::begin(IPAddress address, uint16_t port){
@@ -43,7 +53,7 @@ uint8_t WiFiUDP::begin(IPAddress address, uint16_t port){
 
   server_port = port;
 
-  tx_buffer = new char[1460];
+  tx_buffer = new char[WIFI_UDP_MAX_PACKET_SIZE];
   if(!tx_buffer){
     log_e("could not create tx buffer: %d", errno);
     return 0;
@@ -72,6 +82,7 @@ uint8_t WiFiUDP::begin(IPAddress address, uint16_t port){
     return 0;
   }
   fcntl(udp_server, F_SETFL, O_NONBLOCK);
+  attachReactor();
   return 1;
 }
 
@@ -104,10 +115,15 @@ void WiFiUDP::stop(){
   }
   tx_buffer_len = 0;
   if(rx_buffer){
-    cbuf *b = rx_buffer;
+    free(rx_buffer);
     rx_buffer = NULL;
-    delete b;
   }
+  rx_buffer_len = 0;
+  rx_buffer_pos = 0;
+  _stats.dropped += rx_queue_count;
+  rx_queue_head = 0;
+  rx_queue_count = 0;
+  rx_queue_deferred = false;
   if(udp_server == -1)
     return;
   if(multicast_ip != 0){
@@ -117,6 +133,7 @@ void WiFiUDP::stop(){
     setsockopt(udp_server, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
     multicast_ip = IPAddress(INADDR_ANY);
   }
+  WiFiReactor.remove(udp_server);
   closesocket(udp_server);
   udp_server = -1;
 }
@@ -135,7 +152,7 @@ int WiFiUDP::beginPacket(){
 
   // allocate tx_buffer if is necessary
   if(!tx_buffer){
-    tx_buffer = new char[1460];
+    tx_buffer = new char[WIFI_UDP_MAX_PACKET_SIZE];
     if(!tx_buffer){
       log_e("could not create tx buffer: %d", errno);
       return 0;
@@ -144,18 +161,23 @@ int WiFiUDP::beginPacket(){
 
   tx_buffer_len = 0;
 
+  return openSocket();
+}
+
+bool WiFiUDP::openSocket(){
   // check whereas socket is already open
   if (udp_server != -1)
-    return 1;
+    return true;
 
   if ((udp_server=socket(AF_INET, SOCK_DGRAM, 0)) == -1){
     log_e("could not create socket: %d", errno);
-    return 0;
+    return false;
   }
 
   fcntl(udp_server, F_SETFL, O_NONBLOCK);
+  attachReactor();
 
-  return 1;
+  return true;
 }
 
 int WiFiUDP::beginPacket(IPAddress ip, uint16_t port){
@@ -165,13 +187,13 @@ int WiFiUDP::beginPacket(IPAddress ip, uint16_t port){
 }
 
 int WiFiUDP::beginPacket(const char *host, uint16_t port){
-  struct hostent *server;
-  server = gethostbyname(host);
-  if (server == NULL){
-    log_e("could not get host from dns: %d", errno);
+  IPAddress ip;
+  // cached by hostByName(), so a sender targeting a name does not resolve it per packet
+  if (!WiFiGenericClass::hostByName(host, ip)){
+    log_e("could not get host from dns: %s", host);
     return 0;
   }
-  return beginPacket(IPAddress((const uint8_t *)(server->h_addr_list[0])), port);
+  return beginPacket(ip, port);
 }
 
 int WiFiUDP::endPacket(){
@@ -188,62 +210,245 @@ int WiFiUDP::endPacket(){
 }
 
 size_t WiFiUDP::write(uint8_t data){
-  if(tx_buffer_len == 1460){
-    endPacket();
-    tx_buffer_len = 0;
-  }
-  tx_buffer[tx_buffer_len++] = data;
-  return 1;
+  return write(&data, 1);
 }
 
+/**
+ * append to the packet started with beginPacket(). Data past the end of
+ * the datagram is refused (setWriteError) unless setFragment() allows
+ * sending the full datagram and starting the next one.
+ * @return bytes added
+ */
 size_t WiFiUDP::write(const uint8_t *buffer, size_t size){
-  size_t i;
-  for(i=0;i<size;i++)
-    write(buffer[i]);
-  return i;
+  size_t written = 0;
+  if(!tx_buffer){
+    setWriteError();
+    return 0;
+  }
+  while(written < size){
+    if(tx_buffer_len == WIFI_UDP_MAX_PACKET_SIZE){
+      if(!_fragment){
+        log_e("packet larger than %d bytes", WIFI_UDP_MAX_PACKET_SIZE);
+        setWriteError();
+        break;
+      }
+      if(!endPacket()){
+        break;
+      }
+      tx_buffer_len = 0;
+    }
+    size_t chunk = WIFI_UDP_MAX_PACKET_SIZE - tx_buffer_len;
+    if(chunk > size - written){
+      chunk = size - written;
+    }
+    memcpy(tx_buffer + tx_buffer_len, buffer + written, chunk);
+    tx_buffer_len += chunk;
+    written += chunk;
+  }
+  return written;
+}
+
+/**
+ * let write() send full datagrams and continue in a new one, instead of
+ * refusing data that does not fit into the current packet
+ * @param fragment bool
+ */
+void WiFiUDP::setFragment(bool fragment){
+  _fragment = fragment;
 }
 
+/**
+ * receive the next packet straight into the rx buffer, which is allocated
+ * on first use and kept until stop(). With a receive queue, the queue is
+ * topped up from the socket first and the packet comes out of it
+ * @return size of the packet, 0 if none or the last one is not read yet
+ */
 int WiFiUDP::parsePacket(){
-  if(rx_buffer)
+  if(rx_queue)
+    fillQueue();
+  if(rx_buffer_pos < rx_buffer_len)
     return 0;
+  if(!rx_buffer){
+    rx_buffer = (uint8_t *)malloc(WIFI_UDP_MAX_PACKET_SIZE);
+    if(!rx_buffer){
+      log_e("could not create rx buffer");
+      return 0;
+    }
+  }
+  rx_buffer_len = 0;
+  rx_buffer_pos = 0;
+  if(rx_queue){
+    if(!rx_queue_count)
+      return 0;
+    // hand the slot's buffer out as the current packet, the slot takes the old one
+    wifiUdpPacket_t &slot = rx_queue[rx_queue_head];
+    uint8_t * buf = rx_buffer;
+    rx_buffer = slot.data;
+    slot.data = buf;
+    rx_buffer_len = slot.len;
+    remote_ip = slot.ip;
+    remote_port = slot.port;
+    rx_queue_head = (rx_queue_head + 1) % rx_queue_size;
+    rx_queue_count--;
+    return rx_buffer_len;
+  }
   struct sockaddr_in si_other;
   int slen = sizeof(si_other) , len;
-  char * buf = new char[1460];
-  if(!buf){
-    return 0;
-  }
-  if ((len = recvfrom(udp_server, buf, 1460, MSG_DONTWAIT, (struct sockaddr *) &si_other, (socklen_t *)&slen)) == -1){
-    delete[] buf;
+  if ((len = recvfrom(udp_server, rx_buffer, WIFI_UDP_MAX_PACKET_SIZE, MSG_DONTWAIT, (struct sockaddr *) &si_other, (socklen_t *)&slen)) == -1){
     if(errno == EWOULDBLOCK){
       return 0;
     }
     log_e("could not receive data: %d", errno);
     return 0;
   }
+  _stats.received++;
   remote_ip = IPAddress(si_other.sin_addr.s_addr);
   remote_port = ntohs(si_other.sin_port);
-  if (len > 0) {
-    rx_buffer = new cbuf(len);
-    rx_buffer->write(buf, len);
-  }
-  delete[] buf;
+  rx_buffer_len = len;
   return len;
 }
 
+/**
+ * keep up to packets received datagrams in preallocated slots, so bursts
+ * are taken off the socket whenever it is polled, even while the current
+ * packet is still being read. 0 frees the queue
+ * @param packets uint8_t  number of slots of WIFI_UDP_MAX_PACKET_SIZE bytes
+ * @return false if the slots could not be allocated
+ */
+bool WiFiUDP::setReceiveQueue(uint8_t packets){
+  if(rx_queue){
+    _stats.dropped += rx_queue_count;
+    for(uint8_t i = 0; i < rx_queue_size; i++){
+      free(rx_queue[i].data);
+    }
+    free(rx_queue);
+    rx_queue = NULL;
+  }
+  rx_queue_size = 0;
+  rx_queue_head = 0;
+  rx_queue_count = 0;
+  rx_queue_deferred = false;
+  if(!packets){
+    return true;
+  }
+  rx_queue = (wifiUdpPacket_t *)calloc(packets, sizeof(wifiUdpPacket_t));
+  if(!rx_queue){
+    log_e("could not create receive queue");
+    return false;
+  }
+  for(rx_queue_size = 0; rx_queue_size < packets; rx_queue_size++){
+    wifiUdpPacket_t &slot = rx_queue[rx_queue_size];
+    slot.data = (uint8_t *)malloc(WIFI_UDP_MAX_PACKET_SIZE);
+    if(!slot.data){
+      log_e("could not create receive queue");
+      setReceiveQueue(0);
+      return false;
+    }
+    slot.size = WIFI_UDP_MAX_PACKET_SIZE;
+  }
+  return true;
+}
+
+void WiFiUDP::fillQueue(){
+  while(rx_queue_count < rx_queue_size){
+    uint8_t tail = (rx_queue_head + rx_queue_count) % rx_queue_size;
+    uint8_t span = rx_queue_size - (tail > rx_queue_head || !rx_queue_count ? tail : rx_queue_count);
+    int received = receivePackets(rx_queue + tail, span);
+    if(received <= 0){
+      return;
+    }
+    rx_queue_deferred = false;
+    rx_queue_count += received;
+    _stats.received += received;
+    if(rx_queue_count > _stats.maxQueued){
+      _stats.maxQueued = rx_queue_count;
+    }
+    if(received < span){
+      return;
+    }
+  }
+  // every slot is taken, peek to see whether a datagram is left waiting for one
+  uint8_t probe;
+  if(!rx_queue_deferred && recv(udp_server, &probe, 1, MSG_PEEK | MSG_DONTWAIT) >= 0){
+    rx_queue_deferred = true;
+    _stats.queueFull++;
+  }
+}
+
+const wifiUdpStats_t & WiFiUDP::getStats(){
+  return _stats;
+}
+
+/**
+ * receive up to count queued packets into the caller's buffers in one call,
+ * stopping at the first time nothing is queued. Packets longer than a
+ * buffer are truncated. Independent of parsePacket() and read()
+ * @param packets wifiUdpPacket_t*  data and size set by the caller
+ * @param count size_t
+ * @return number of packets received, -1 on error before the first one
+ */
+int WiFiUDP::receivePackets(wifiUdpPacket_t *packets, size_t count){
+  size_t received = 0;
+  if(udp_server == -1){
+    return -1;
+  }
+  while(received < count){
+    wifiUdpPacket_t &packet = packets[received];
+    struct sockaddr_in si_other;
+    socklen_t slen = sizeof(si_other);
+    int len = recvfrom(udp_server, packet.data, packet.size, MSG_DONTWAIT, (struct sockaddr *) &si_other, &slen);
+    if(len < 0){
+      if(errno != EWOULDBLOCK){
+        log_e("could not receive data: %d", errno);
+        if(!received){
+          return -1;
+        }
+      }
+      break;
+    }
+    packet.len = len;
+    packet.ip = IPAddress(si_other.sin_addr.s_addr);
+    packet.port = ntohs(si_other.sin_port);
+    received++;
+  }
+  return received;
+}
+
+/**
+ * send count packets, each to its own recipient, without going through
+ * the beginPacket()/write()/endPacket() buffer
+ * @param packets const wifiUdpPacket_t*  data, len, ip and port set by the caller
+ * @param count size_t
+ * @return number of packets sent, sending stops at the first failure
+ */
+int WiFiUDP::sendPackets(const wifiUdpPacket_t *packets, size_t count){
+  size_t sent = 0;
+  if(!openSocket()){
+    return 0;
+  }
+  struct sockaddr_in recipient;
+  memset(&recipient, 0, sizeof(recipient));
+  recipient.sin_family = AF_INET;
+  while(sent < count){
+    const wifiUdpPacket_t &packet = packets[sent];
+    recipient.sin_addr.s_addr = (uint32_t)packet.ip;
+    recipient.sin_port = htons(packet.port);
+    if(sendto(udp_server, packet.data, packet.len, 0, (struct sockaddr*) &recipient, sizeof(recipient)) < 0){
+      log_e("could not send data: %d", errno);
+      break;
+    }
+    sent++;
+  }
+  return sent;
+}
+
 int WiFiUDP::available(){
-  if(!rx_buffer) return 0;
-  return rx_buffer->available();
+  return rx_buffer_len - rx_buffer_pos;
 }
 
 int WiFiUDP::read(){
-  if(!rx_buffer) return -1;
-  int out = rx_buffer->read();
-  if(!rx_buffer->available()){
-    cbuf *b = rx_buffer;
-    rx_buffer = 0;
-    delete b;
-  }
-  return out;
+  if(rx_buffer_pos == rx_buffer_len) return -1;
+  return rx_buffer[rx_buffer_pos++];
 }
 
 int WiFiUDP::read(unsigned char* buffer, size_t len){
@@ -251,28 +456,34 @@ int WiFiUDP::read(unsigned char* buffer, size_t len){
 }
 
 int WiFiUDP::read(char* buffer, size_t len){
-  if(!rx_buffer) return 0;
-  int out = rx_buffer->read(buffer, len);
-  if(!rx_buffer->available()){
-    cbuf *b = rx_buffer;
-    rx_buffer = 0;
-    delete b;
+  size_t left = rx_buffer_len - rx_buffer_pos;
+  if(len > left){
+    len = left;
   }
-  return out;
+  if(!len) return 0;
+  memcpy(buffer, rx_buffer + rx_buffer_pos, len);
+  rx_buffer_pos += len;
+  return len;
 }
 
 int WiFiUDP::peek(){
-  if(!rx_buffer) return -1;
-  return rx_buffer->peek();
+  if(rx_buffer_pos == rx_buffer_len) return -1;
+  return rx_buffer[rx_buffer_pos];
+}
+
+/**
+ * unread part of the current packet, available() bytes long, without
+ * copying it. Valid until the next parsePacket(), clear() or stop()
+ */
+const uint8_t * WiFiUDP::data(){
+  return rx_buffer ? rx_buffer + rx_buffer_pos : NULL;
 }
 
 void WiFiUDP::flush(){}
 
 void WiFiUDP::clear(){
-  if(!rx_buffer) return;
-  cbuf *b = rx_buffer;
-  rx_buffer = 0;
-  delete b;
+  rx_buffer_len = 0;
+  rx_buffer_pos = 0;
 }
 
 IPAddress WiFiUDP::remoteIP(){
@@ -282,3 +493,30 @@ IPAddress WiFiUDP::remoteIP(){
 uint16_t WiFiUDP::remotePort(){
   return remote_port;
 }
+
+/**
+ * let WiFiReactor.poll() receive packets: the callback runs for every
+ * packet with it parsed like after parsePacket(), unread data is
+ * dropped when it returns. nullptr goes back to polling parsePacket()
+ */
+void WiFiUDP::onReceive(ReceiveCallback callback){
+  _onReceive = callback;
+  attachReactor();
+}
+
+void WiFiUDP::attachReactor(){
+  if(udp_server == -1)
+    return;
+  if(!_onReceive){
+    WiFiReactor.remove(udp_server);
+    return;
+  }
+  WiFiReactor.add(udp_server, WIFI_REACTOR_READ, [this](int fd, uint8_t events){
+    clear();
+    // a receive queue may hold more than the packet that made the socket readable
+    while(parsePacket() > 0 && _onReceive){
+      _onReceive(*this);
+      clear();
+    }
+  });
+}
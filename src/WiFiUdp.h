@@ -37,9 +37,30 @@
 
 #include <Arduino.h>
 #include <Udp.h>
-#include <cbuf.h>
+#include <functional>
+
+/// largest datagram payload that goes out unfragmented over WiFi
+#define WIFI_UDP_MAX_PACKET_SIZE (1460)
+
+typedef struct {
+  uint8_t * data;   // caller-provided buffer
+  size_t size;      // capacity of data when receiving
+  size_t len;       // bytes received, or bytes to send
+  IPAddress ip;     // sender when receiving, recipient when sending
+  uint16_t port;
+} wifiUdpPacket_t;
+
+typedef struct {
+  uint32_t received;    // packets taken from the socket
+  uint32_t queueFull;   // datagrams that had to wait in the socket for a free queue slot, each counted once
+  uint32_t dropped;     // queued packets discarded unread by stop() or setReceiveQueue()
+  uint8_t maxQueued;    // highest number of packets waiting in the receive queue
+} wifiUdpStats_t;
 
 class WiFiUDP : public UDP {
+public:
+  typedef std::function<void(WiFiUDP &udp)> ReceiveCallback;
+
 private:
   int udp_server;
   IPAddress multicast_ip;
@@ -48,7 +69,21 @@ private:
   uint16_t remote_port;
   char * tx_buffer;
   size_t tx_buffer_len;
-  cbuf * rx_buffer;
+  uint8_t * rx_buffer;   // allocated once, holds the last received packet
+  size_t rx_buffer_len;
+  size_t rx_buffer_pos;
+  wifiUdpPacket_t * rx_queue;   // packets received ahead of parsePacket()
+  uint8_t rx_queue_size;
+  uint8_t rx_queue_head;
+  uint8_t rx_queue_count;
+  bool rx_queue_deferred;   // a datagram waiting in the socket was counted in queueFull
+  wifiUdpStats_t _stats;
+  ReceiveCallback _onReceive;
+  bool _fragment;
+
+  void attachReactor();
+  bool openSocket();
+  void fillQueue();
 public:
   WiFiUDP();
   ~WiFiUDP();
@@ -63,16 +98,24 @@ public:
   int endPacket();
   size_t write(uint8_t);
   size_t write(const uint8_t *buffer, size_t size);
+  void setFragment(bool fragment);
   int parsePacket();
+  int receivePackets(wifiUdpPacket_t *packets, size_t count);
+  int sendPackets(const wifiUdpPacket_t *packets, size_t count);
+  bool setReceiveQueue(uint8_t packets);
+  const wifiUdpStats_t & getStats();
   int available();
   int read();
   int read(unsigned char* buffer, size_t len);
   int read(char* buffer, size_t len);
   int peek();
+  const uint8_t * data();
   void flush();
   void clear();
   IPAddress remoteIP();
   uint16_t remotePort();
+  int fd() const { return udp_server; }
+  void onReceive(ReceiveCallback callback);
 };
 
 #endif /* _WIFIUDP_H_ */